@@ -0,0 +1,91 @@
+#pragma once
+
+#include <NonEuclideanEngine/shader.hpp>
+
+#include <vector>
+
+namespace Knee {
+	class VisualPortal;
+
+	// a room or sector of the world.  objects belong to a cell, and cells are connected to eachother through visual portals
+	// anything that isn't added to a cell is treated as being in every cell
+	class Cell {
+		// everything in the cell, including its portals
+		std::vector<Knee::RenderableObject*> m_renderableObjects;
+
+		// portals in the cell, which look into the cells of their pairs
+		std::vector<Knee::VisualPortal*> m_visualPortals;
+
+		// potentially visible set, filled in by CellGraph::computeVisibility //
+
+		// cells that could be seen from anywhere in this cell through any number of portals, including this cell
+		std::vector<Knee::Cell*> m_visibleCells;
+
+		// what a view of this cell has to consider, which is our own objects plus everything that isn't in a cell
+		std::vector<Knee::RenderableObject*> m_visibleObjects;
+
+		// what views of this cell actually draw, which is the visible objects with any that have been batched replaced by their batches
+		std::vector<Knee::RenderableObject*> m_drawnObjects;
+
+		// portals in any of the visible cells plus any that aren't in a cell, which are all of the portals that could be seen from here
+		std::vector<Knee::VisualPortal*> m_visiblePortals;
+
+		// index into the graph, used while computing visibility
+		uint32_t m_index = 0;
+
+		friend class CellGraph;
+
+		public:
+			Cell();
+
+			void addRenderableObject(Knee::RenderableObject* obj);
+
+			// adds the portal as a renderable object too
+			void addVisualPortal(Knee::VisualPortal* portal);
+
+			std::vector<Knee::RenderableObject*>* getRenderableObjects();
+			std::vector<Knee::VisualPortal*>* getVisualPortals();
+
+			std::vector<Knee::Cell*>* getVisibleCells();
+			std::vector<Knee::RenderableObject*>* getVisibleObjects();
+
+			// the same as the visible objects until static batches are baked, see StaticBatcher::substitute
+			std::vector<Knee::RenderableObject*>* getDrawnObjects();
+			std::vector<Knee::VisualPortal*>* getVisiblePortals();
+
+			bool canSee(Knee::Cell* cell);
+	};
+
+	// all of the cells in the world, along with what can be seen from each of them
+	class CellGraph {
+		std::vector<Knee::Cell*> m_cells;
+
+		// set once computeVisibility has been called, and cleared whenever a cell is added after that
+		bool m_computed = false;
+
+		// a cell is reached by looking through a portal from one of its sides
+		// the view through the portal is on the far side of its pair, so anything behind the pair can't be seen from there
+		struct VisibilityState {
+			Knee::VisualPortal* portal;
+
+			// which side of the portal it's looked at from, 1 for in front (along its local z axis) and -1 for behind
+			float side;
+		};
+
+		// marks every cell that can be seen from cell, following portal chains as long as each portal is at least partly behind the pair of the one before it
+		void addVisibleCells(Knee::Cell* cell, const std::vector<Knee::VisualPortal*>& allPortals, const std::vector<Knee::VisualPortal*>& sharedPortals, std::vector<bool>& visible);
+
+		public:
+			CellGraph();
+
+			void addCell(Knee::Cell* cell);
+
+			// find which cells can be seen from each cell and build their visible object + portal lists
+			// this is done once when a level is loaded, and needs to be done again if any cell, portal pair, or portal position changes
+			void computeVisibility(std::vector<Knee::RenderableObject*>* renderableObjects, std::vector<Knee::VisualPortal*>* visualPortals);
+
+			bool isComputed();
+
+			std::vector<Knee::Cell*>* getCells();
+	};
+}
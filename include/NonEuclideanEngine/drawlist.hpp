@@ -0,0 +1,108 @@
+#pragma once
+
+#include <NonEuclideanEngine/shader.hpp>
+#include <NonEuclideanEngine/renderqueue.hpp>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+
+namespace Knee {
+	// everything needed to draw an object, worked out once per frame
+	struct DrawItem {
+		Knee::RenderableObject* object = NULL;
+
+		Knee::RenderableObjectShaderProgram* program = NULL;
+		const Knee::VertexData* vertexData = NULL;
+		Knee::Texture2D* texture = NULL;
+
+		// where the object's matrices are in the transform buffer, in items
+		uint32_t index = 0;
+
+		// lowest layer the object is on, which passes draw in order
+		uint32_t layer = 0;
+
+		// world space bounding sphere + largest scale axis, for culling and picking levels of detail
+		glm::vec3 center = glm::vec3(0);
+		float radius = 0.0f;
+		float maxScale = 1.0f;
+
+		// drawn by calling the object's own draw, since it sets up more than the usual uniforms
+		bool custom = false;
+	};
+
+	// objects compiled into draw items the first time they're drawn in a frame, then replayed for every pass with only the camera changing
+	// the model matrices of every item are uploaded once per frame to a texture buffer, and each pass draws every run of items that share a program, texture and vertex data with one instanced draw
+	// objects can't move between beginFrame and the last pass of the frame
+	class DrawList {
+		// a texture buffer that data is appended to over a frame, then orphaned at the start of the next so that the driver doesn't have to wait for passes still reading it
+		// created on first use so that we don't need a gl context to construct a draw list
+		struct StreamingTextureBuffer {
+			GLenum format;
+
+			GLuint buffer = 0;
+			GLuint texture = 0;
+
+			// in bytes
+			size_t capacity = 0;
+			size_t uploadedSize = 0;
+
+			void orphan();
+
+			// upload whatever part of the frame's data hasn't been yet, then bind the texture to the unit
+			void upload(const void* data, size_t size, GLuint unit);
+
+			void destroy();
+		};
+
+		// unique across every draw list, so an object's index can never be mistaken for one from another frame
+		static uint64_t LATEST_FRAME;
+
+		// texture units the transform + instance buffers are bound to, after the one used by object textures
+		const static uint32_t TRANSFORM_TEXTURE_UNIT = 1;
+		const static uint32_t INSTANCE_TEXTURE_UNIT = 2;
+
+		uint64_t m_frame = 0;
+
+		std::vector<Knee::DrawItem> m_items;
+
+		// model matrix columns for every item, TRANSFORM_TEXELS each
+		std::vector<glm::vec4> m_transforms;
+		Knee::DrawList::StreamingTextureBuffer m_transformBuffer;
+
+		// item indices of every instance drawn this frame, in the order they're drawn.  each pass appends its own
+		std::vector<uint32_t> m_instances;
+		Knee::DrawList::StreamingTextureBuffer m_instanceBuffer;
+
+		// the draws of the pass being drawn, sorted to keep state changes down
+		Knee::RenderQueue m_queue;
+
+		// level of detail picked for each object in the pass being drawn
+		std::vector<const Knee::VertexData*> m_passVertexData;
+
+		// number of draw calls made since beginFrame
+		uint32_t m_drawCallCount = 0;
+
+		public:
+			// how many RGBA32F texels each item takes up in the transform buffer, one per model matrix column
+			// nothing is lit yet, so normal matrices aren't uploaded
+			const static uint32_t TRANSFORM_TEXELS = 4;
+
+			DrawList();
+			~DrawList();
+
+			// forget everything compiled last frame
+			void beginFrame();
+
+			// get the item for an object, compiling it if it hasn't been used yet this frame
+			const Knee::DrawItem& getItem(Knee::RenderableObject* obj);
+
+			// draw the objects from wherever their shader program's camera is, sorted by layer, then by state, then front to back
+			// gl state is only changed when the next run of items needs something different
+			void draw(const std::vector<Knee::RenderableObject*>& objects);
+
+			uint32_t getItemCount();
+			uint32_t getDrawCallCount();
+	};
+}
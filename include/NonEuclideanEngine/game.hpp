@@ -5,6 +5,9 @@
 #include <NonEuclideanEngine/gameobjects.hpp>
 #include <NonEuclideanEngine/player.hpp>
 #include <NonEuclideanEngine/portal.hpp>
+#include <NonEuclideanEngine/cell.hpp>
+#include <NonEuclideanEngine/drawlist.hpp>
+#include <NonEuclideanEngine/staticbatch.hpp>
 
 #include <SDL2/SDL.h>
 #include <glm/glm.hpp>
@@ -23,10 +26,11 @@ namespace Knee {
 		static const std::string VISUAL_PORTAL_SHADER_ROOT;
 		static const std::string VISUAL_PORTAL_VERTEX_SHADER_PATH;
 		static const std::string VISUAL_PORTAL_FRAGMENT_SHADER_PATH;
-		static const std::string RENDERABLE_GAMEOBJECT_WITH_DEPTH_SHADER_ROOT;
-		static const std::string RENDERABLE_GAMEOBJECT_WITH_DEPTH_VERTEX_SHADER_PATH;
-		static const std::string RENDERABLE_GAMEOBJECT_WITH_DEPTH_FRAGMENT_SHADER_PATH;
 		
+		// size of the window being rendered to
+		uint32_t m_windowWidth;
+		uint32_t m_windowHeight;
+
 		// the player
 		Knee::Player m_player;
 		
@@ -38,6 +42,15 @@ namespace Knee {
 		
 		// list of all renderable objects, added to whenever a type of renderable game object is added
 		std::vector<RenderableObject*> m_renderableGameObjects;
+
+		// the renderable objects added as static ones, which are the only ones that can be batched
+		std::vector<RenderableObject*> m_staticRenderableObjects;
+
+		// static objects merged into batches, baked the first frame after anything is added + again whenever a batched object moves
+		Knee::StaticBatcher m_staticBatcher;
+
+		// what's actually drawn out of the renderable objects, with batched objects replaced by their batches
+		std::vector<RenderableObject*> m_drawnRenderableObjects;
 		
 		// vector of all visual portals
 		// portals themselves are stored as static game objects when mapped by id	
@@ -46,16 +59,52 @@ namespace Knee {
 		// vector of all portals
 		std::vector<Portal*> m_portals;
 
+		// map of all cells, mapped by id
+		std::map<std::string, Cell*> m_cells;
+
+		// the cells that the world is split into + what can be seen from each of them
+		Knee::CellGraph m_cellGraph;
+
+		// the cell the player is in, which changes when the player goes through a portal into another cell
+		// NULL if the player isn't in a cell, in which case everything is considered from every view
+		Knee::Cell* m_playerCell = NULL;
+
+		// layers drawn in the main view.  layers drawn through portals are set on the view tree
+		uint32_t m_layerMask = RENDER_LAYER_ALL;
+
+		// how visual portals are rendered
+		Knee::PortalRenderMode m_portalRenderMode = PORTAL_RENDER_MODE_FRAMEBUFFER;
+
+		// render targets for visual portals, handed out as they're needed each frame
+		Knee::FramebufferPool m_framebufferPool;
+
+		// everything that can be seen through visual portals this frame, rebuilt every frame
+		Knee::PortalViewTree m_portalViewTree;
+
+		// every object drawn this frame, compiled once and replayed by the main view + every portal pass
+		Knee::DrawList m_drawList;
+
+		// what the main view draws this frame
+		std::vector<RenderableObject*> m_mainPassObjects;
+
 		// shaders
 		Knee::RenderableObjectShaderProgram m_renderableGameObjectShaderProgram;
 		Knee::RenderableObjectShaderProgram m_visualPortalShaderProgram;
-		Knee::RenderableObjectShaderProgram m_renderableGameObjectWithDepthShaderProgram;
+
+		// rebuild the drawn object lists of the game + every cell from the current batches
+		void updateDrawnObjects();
+
+		// the drawn version of getVisibleRenderableObjects
+		std::vector<RenderableObject*>* getDrawnRenderableObjects();
 
 		public:
 			Game(uint32_t, uint32_t);
 			~Game();
 		
 			Knee::Player* getPlayer();
+			Knee::FramebufferPool* getFramebufferPool();
+			Knee::PortalViewTree* getPortalViewTree();
+			Knee::DrawList* getDrawList();
 			
 			void initialize();
 			
@@ -71,6 +120,28 @@ namespace Knee {
 			void addVisualPortal(std::string id, VisualPortal* portal);
 			void addPortal(std::string id, Portal* portal);
 
+			// objects + portals are added to cells with Cell::addRenderableObject and Cell::addVisualPortal, but still need to be added to the game as usual
+			void addCell(std::string id, Cell* cell);
+			Knee::Cell* getCell(std::string id);
+
+			// finds what can be seen from each cell.  call once every cell has been filled in, before setting the player's cell
+			void computeCellVisibility();
+
+			// merge static objects that share a cell, program, texture and layers into batches.  done automatically before the first frame is rendered after anything is added, but can be called after loading a level to get it out of the way
+			void bakeStaticBatches();
+
+			// throw the batches away so that they're baked again next frame.  call after changing a static object's texture, shader program, layers, or vertex data (moving it is noticed without this)
+			void invalidateStaticBatches();
+
+			Knee::StaticBatcher* getStaticBatcher();
+
+			Knee::Cell* getPlayerCell();
+			void setPlayerCell(Knee::Cell* cell);
+
+			// what can be seen from the player's cell, or everything if cells aren't being used
+			std::vector<RenderableObject*>* getVisibleRenderableObjects();
+			std::vector<VisualPortal*>* getVisibleVisualPortals();
+
 			void updateGameObjects(double);
 			void updatePlayer(double);
 			
@@ -79,6 +150,22 @@ namespace Knee {
 			void updateVisualPortals();
 			bool updatePortals(double delta);
 
+			// renders visual portal contents directly into the default framebuffer (stencil render mode only)
+			void renderVisualPortalsStencil();
+
+			// tests every visual portal in the main view's frustum against its depth, so that the next frame can skip any that are hidden
+			// anything outside the frustum isn't tested, so it's treated as visible next frame instead of hidden
+			void queryVisualPortalOcclusion();
+
+			// forget every occlusion result, for when the next frame's view has nothing to do with this one's (like after going through a portal)
+			void clearVisualPortalOcclusion();
+
+			uint32_t getLayerMask();
+			void setLayerMask(uint32_t layerMask);
+
+			Knee::PortalRenderMode getPortalRenderMode();
+			void setPortalRenderMode(Knee::PortalRenderMode renderMode);
+
 			void renderScene();
 
 			void update(double delta);
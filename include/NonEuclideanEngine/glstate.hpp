@@ -0,0 +1,128 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <map>
+#include <cstdint>
+
+namespace Knee {
+	// kinds of state GLState keeps track of, each with its own counters
+	enum GLStateCounter {
+		STATE_COUNTER_PROGRAM,
+		STATE_COUNTER_VERTEX_ARRAY,
+		STATE_COUNTER_TEXTURE,
+		STATE_COUNTER_FRAMEBUFFER,
+		STATE_COUNTER_VIEWPORT,
+		STATE_COUNTER_CAPABILITY,
+		STATE_COUNTER_DEPTH,
+		STATE_COUNTER_COLOR_MASK,
+		STATE_COUNTER_STENCIL,
+		STATE_COUNTER_SCISSOR,
+
+		STATE_COUNTER_COUNT
+	};
+
+	// remembers what is bound to the gl context, so that binding something that's already bound doesn't reach the driver
+	// all engine code changes this state through here.  anything that changes it directly has to call reset afterwards, otherwise binds could be skipped that shouldn't be
+	class GLState {
+		// nothing known about the state, so the next call has to go through
+		const static GLuint UNKNOWN = 0xFFFFFFFF;
+
+		// textures are only tracked for this many units, anything above is always bound
+		const static uint32_t MAX_TRACKED_TEXTURE_UNITS = 16;
+
+		// texture targets that are tracked, anything else is always bound
+		enum TextureTarget {
+			TEXTURE_TARGET_2D,
+			TEXTURE_TARGET_BUFFER,
+
+			TEXTURE_TARGET_COUNT
+		};
+
+		static GLuint PROGRAM;
+		static GLuint VERTEX_ARRAY;
+
+		static GLuint ACTIVE_TEXTURE_UNIT;
+		static GLuint TEXTURES[MAX_TRACKED_TEXTURE_UNITS][TEXTURE_TARGET_COUNT];
+
+		static GLuint DRAW_FRAMEBUFFER;
+		static GLuint READ_FRAMEBUFFER;
+
+		// x, y, width, height.  width is UNKNOWN if the viewport is
+		static GLint VIEWPORT[4];
+
+		// capabilities that have been enabled or disabled, anything else is unknown
+		static std::map<GLenum, bool> CAPABILITIES;
+
+		// UNKNOWN if unknown
+		static GLuint DEPTH_FUNC;
+		static GLuint DEPTH_MASK;
+		static GLuint COLOR_MASK;
+
+		// near, far.  NAN if unknown
+		static GLfloat DEPTH_RANGE[2];
+
+		// func, ref, mask + stencil fail, depth fail, depth pass ops.  UNKNOWN if unknown
+		static GLuint STENCIL_FUNC[3];
+		static GLuint STENCIL_OP[3];
+		static GLuint STENCIL_MASK;
+
+		// x, y, width, height.  width is UNKNOWN if the scissor box is
+		static GLint SCISSOR[4];
+
+		static uint64_t ISSUED_COUNTS[STATE_COUNTER_COUNT];
+		static uint64_t SKIPPED_COUNTS[STATE_COUNTER_COUNT];
+
+		// returns true if the call has to go to the driver, counting it either way
+		static bool change(Knee::GLStateCounter counter, GLuint& current, GLuint value);
+
+		// the same for state set as several values at once
+		static bool change(Knee::GLStateCounter counter, GLuint* current, const GLuint* values, uint32_t count);
+
+		static int32_t getTextureTarget(GLenum target);
+		static void setActiveTextureUnit(GLuint unit);
+
+		public:
+			// forget everything, for when the context is created or something else has changed its state
+			static void reset();
+
+			static void useProgram(GLuint program);
+			static void bindVertexArray(GLuint vertexArray);
+			// also leaves the unit active, so the texture can be edited straight after
+			static void bindTexture(GLuint unit, GLenum target, GLuint texture);
+
+			// GL_FRAMEBUFFER binds both the draw and read framebuffers, like it does in gl
+			static void bindFramebuffer(GLenum target, GLuint framebuffer);
+
+			static void setViewport(GLint x, GLint y, GLsizei width, GLsizei height);
+
+			static void setEnabled(GLenum capability, bool enabled);
+			static void enable(GLenum capability);
+			static void disable(GLenum capability);
+
+			static void setDepthFunc(GLenum func);
+			static void setDepthMask(bool mask);
+			static void setDepthRange(GLfloat nearValue, GLfloat farValue);
+
+			// front + back faces at once, since that's all the engine uses
+			static void setStencilFunc(GLenum func, GLint ref, GLuint mask);
+			static void setStencilOp(GLenum stencilFail, GLenum depthFail, GLenum depthPass);
+			static void setStencilMask(GLuint mask);
+
+			static void setScissor(GLint x, GLint y, GLsizei width, GLsizei height);
+
+			// all four channels at once, since that's all the engine uses
+			static void setColorMask(bool mask);
+
+			// deleting something that's bound unbinds it, so these forget it as well
+			static void deleteProgram(GLuint program);
+			static void deleteVertexArray(GLuint vertexArray);
+			static void deleteTexture(GLuint texture);
+			static void deleteFramebuffer(GLuint framebuffer);
+
+			// how many calls went to the driver + how many were skipped since the last resetCounters
+			static uint64_t getIssuedCount(Knee::GLStateCounter counter);
+			static uint64_t getSkippedCount(Knee::GLStateCounter counter);
+			static void resetCounters();
+	};
+}
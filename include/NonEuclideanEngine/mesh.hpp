@@ -0,0 +1,137 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <cstdint>
+
+namespace Knee {
+	// a simplified copy of a mesh, made by MeshSimplifier in the same vertex layout as the data it was made from
+	struct MeshLOD {
+		std::vector<float> data;
+		uint32_t vertexCount = 0;
+
+		// about how far (in model units) any part of the surface may have moved from where it was in the original mesh
+		float error = 0.0f;
+	};
+
+	// simplifies triangle meshes by repeatedly collapsing whichever edge changes the shape the least, measured with quadric error metrics (Garland + Heckbert)
+	// vertices with the same position are welded together first, so meshes with hard edges or texture seams still simplify as one surface
+	class MeshSimplifier {
+		// error for moving along the border of an open mesh is scaled by this, so that holes don't grow as the mesh gets simpler
+		constexpr static double BOUNDARY_WEIGHT = 1000.0;
+
+		// simplification stops once there are this few triangles left, and no collapse is allowed to leave fewer
+		const static uint32_t MIN_TRIANGLES = 4;
+
+		// the next level is only kept if it has at most this fraction of the triangles of the level before it, otherwise it isn't worth drawing instead
+		constexpr static float MAX_LEVEL_TRIANGLE_FRACTION = 0.75f;
+
+		// weighted sum of squared distances to a set of planes, stored as the upper triangle of a symmetric 4x4 matrix
+		struct Quadric {
+			double m[10] = { 0 };
+			double weight = 0.0;
+
+			void addPlane(glm::vec3 normal, float distance, double weight);
+			void add(const Quadric& other);
+
+			// average squared distance to the planes, so that error doesn't just grow with how many planes have been merged
+			double evaluate(glm::vec3 p) const;
+		};
+
+		struct Triangle {
+			// welded positions, which change as edges are collapsed
+			uint32_t positions[3];
+
+			// the vertices of the original data that each corner takes its other attributes from
+			uint32_t vertices[3];
+
+			bool removed = false;
+		};
+
+		// moving position "from" onto position "to", removing every triangle that used both
+		struct Collapse {
+			double cost;
+			uint32_t from;
+			uint32_t to;
+
+			// collapses are stale once either position has been changed by another collapse
+			uint32_t fromVersion;
+			uint32_t toVersion;
+		};
+
+		// everything used while simplifying one mesh
+		struct State {
+			std::vector<glm::vec3> positions;
+			std::vector<Quadric> quadrics;
+			std::vector<uint32_t> versions;
+			std::vector<bool> removed;
+
+			std::vector<Triangle> triangles;
+			std::vector<std::vector<uint32_t>> positionTriangles;
+
+			// heap of collapses, cheapest first
+			std::vector<Collapse> collapses;
+
+			uint32_t triangleCount = 0;
+		};
+
+		static void weld(const float* data, uint32_t vertexCount, uint32_t stride, uint32_t positionOffset, State& state);
+		static void addQuadrics(State& state);
+
+		// adds the cheapest direction of every edge around the position
+		static void addCollapses(State& state, uint32_t position);
+		static bool compareCost(const Collapse& a, const Collapse& b);
+
+		// false if moving the position would turn any of the triangles around it inside out
+		static bool canCollapse(State& state, uint32_t from, uint32_t to);
+		static void collapse(State& state, uint32_t from, uint32_t to);
+
+		static void getLOD(const State& state, const float* data, uint32_t stride, uint32_t positionOffset, Knee::MeshLOD& lod);
+
+		public:
+			// make up to levelCount simplified copies of non-indexed triangle data with the given stride + offset of the position in each vertex (in floats)
+			// each level has about half of the triangles of the one before it, and levels stop early once the mesh can't be simplified any further
+			static void generateLODs(const float* data, uint32_t vertexCount, uint32_t stride, uint32_t positionOffset, uint32_t levelCount, std::vector<Knee::MeshLOD>& lods);
+	};
+
+	// turns triangle lists into indexed vertices, and orders them so that the gpu has to transform + fetch as few vertices as possible
+	class MeshIndexer {
+		// how many vertices the post-transform cache is assumed to hold.  real hardware varies, and tipsify isn't very sensitive to this
+		const static uint32_t VERTEX_CACHE_SIZE = 16;
+
+		// everything used while reordering one mesh's triangles
+		struct CacheState {
+			// triangles using each vertex, as ranges of vertexTriangles
+			std::vector<uint32_t> triangleOffsets;
+			std::vector<uint32_t> vertexTriangles;
+
+			// triangles using each vertex that haven't been emitted yet
+			std::vector<uint32_t> liveTriangles;
+
+			// when each vertex last entered the simulated cache
+			std::vector<uint32_t> cacheTimes;
+			uint32_t timestamp = 0;
+
+			// vertices of recently emitted triangles, checked when the fan runs out of neighbours
+			std::vector<uint32_t> deadEnds;
+
+			// vertices below this have no triangles left
+			uint32_t cursor = 0;
+		};
+
+		// the vertex to fan around next, or -1 once every triangle has been emitted
+		static int32_t getNextVertex(CacheState& state, const std::vector<uint32_t>& candidates);
+		static int32_t skipDeadEnd(CacheState& state);
+
+		public:
+			// store each distinct vertex of non-indexed data once, with an index per original vertex
+			static void index(const float* data, uint32_t vertexCount, uint32_t stride, std::vector<float>& vertices, std::vector<uint32_t>& indices);
+
+			// reorder triangles so that neighbouring ones reuse vertices while they're still in the post-transform cache (tipsify, Sander et al. 2007)
+			static void optimizeVertexCache(std::vector<uint32_t>& indices, uint32_t vertexCount);
+
+			// reorder vertices to the order they're first used in, so that fetching them walks through memory
+			static void optimizeVertexFetch(std::vector<float>& vertices, uint32_t stride, std::vector<uint32_t>& indices);
+	};
+}
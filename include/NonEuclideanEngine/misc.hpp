@@ -6,6 +6,7 @@
 
 #include <iostream>
 #include <string>
+#include <vector>
 #include <chrono>
 
 namespace Knee {
@@ -58,6 +59,12 @@ namespace Knee {
 
 		// model matrix
 		glm::mat4 m_modelMatrix = glm::mat4(1);
+
+		// the newest version handed out to any object
+		static uint64_t LATEST_TRANSFORM_VERSION;
+
+		// changes every time the transformation changes, and is always newer than any version handed out before
+		uint64_t m_transformVersion = 0;
 		
 		public:
 			// constructors //
@@ -153,6 +160,70 @@ namespace Knee {
 
 			// based on the current values of the transformation matrices			
 			void updateModelMatrix();
+
+			// change tracking //
+
+			// compare against getLatestTransformVersion() at some point in time to find out if the transformation has changed since then
+			uint64_t getTransformVersion() const ;
+			static uint64_t getLatestTransformVersion();
+	};
+
+	// an axis aligned rectangle in normalized device coordinates, used to describe which part of the screen something covers
+	class ScreenRect {
+		glm::vec2 m_min = glm::vec2(-1);
+		glm::vec2 m_max = glm::vec2(1);
+
+		public:
+			// defaults to the whole screen
+			ScreenRect();
+			ScreenRect(glm::vec2 min, glm::vec2 max);
+
+			glm::vec2 getMin() const ;
+			glm::vec2 getMax() const ;
+			glm::vec2 getSize() const ;
+			glm::vec2 getCenter() const ;
+
+			bool isEmpty() const ;
+
+			ScreenRect intersection(const ScreenRect& other) const ;
+
+			// expands the rectangle outwards so that its edges lie on pixel boundaries of a screen with the given size
+			ScreenRect snappedToPixels(uint32_t screenWidth, uint32_t screenHeight) const ;
+
+			// size of the rectangle in pixels on a screen with the given size
+			glm::vec2 getPixelSize(uint32_t screenWidth, uint32_t screenHeight) const ;
+
+			// matrix which stretches this rectangle over the whole of NDC when applied after projection
+			glm::mat4 getCropMatrix() const ;
+
+			// transformation from NDC of a view cropped to drawnIn into texture coordinates of a texture which was rendered cropped to this rectangle
+			glm::mat3 getSampleTransform(const ScreenRect& drawnIn) const ;
+
+			// transformation from NDC of a view cropped to this rectangle back to uncropped NDC
+			glm::mat3 getUncropTransform() const ;
+	};
+
+	// a convex volume bounded by planes, used to reject objects that can't be seen
+	class Frustum {
+		// planes stored as (normal, distance) with normals pointing inwards, so a point p is inside a plane when dot(normal, p) + distance >= 0
+		std::vector<glm::vec4> m_planes;
+
+		public:
+			Frustum();
+
+			// create a frustum from the six clip planes of a (projection * view) matrix
+			Frustum(glm::mat4 viewProjection);
+
+			// add a plane which passes through point with the given normal pointing inwards
+			void addPlane(glm::vec3 point, glm::vec3 normal);
+
+			// add the four planes going from eye through each edge of a convex quad, narrowing the frustum to only what can be seen through the quad
+			void addQuadPlanes(glm::vec3 eye, const glm::vec3 quad[4]);
+
+			uint32_t getPlaneCount();
+
+			// false only if the sphere is entirely outside of at least one plane
+			bool intersectsSphere(glm::vec3 center, float radius) const ;
 	};
 
 	class MathUtils {
@@ -190,5 +261,13 @@ namespace Knee {
 				const glm::vec2& boxCenter,
 				const glm::vec2& boxSize
 			);
+
+			// find the projective transformation mapping each corner of one 2D quad onto the same corner of another
+			// both quads must be in the same winding order, returns false if either is degenerate
+			// https://www.cs.cmu.edu/~ph/texfund/texfund.pdf (Heckbert, section 2.2)
+			static bool computeHomography(const glm::vec2 from[4], const glm::vec2 to[4], glm::mat3& homography);
+
+			// transformation mapping the unit square (0, 0), (1, 0), (1, 1), (0, 1) onto the quad
+			static bool computeSquareToQuad(const glm::vec2 quad[4], glm::mat3& transform);
 	};
 }
\ No newline at end of file
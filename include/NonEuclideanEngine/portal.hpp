@@ -3,61 +3,318 @@
 #include <NonEuclideanEngine/misc.hpp>
 #include <NonEuclideanEngine/gameobjects.hpp>
 #include <NonEuclideanEngine/player.hpp>
+#include <NonEuclideanEngine/texture.hpp>
+#include <NonEuclideanEngine/drawlist.hpp>
+
+#include <deque>
+#include <map>
 
 namespace Knee {
+	// the method used to render what can be seen through visual portals
+	enum PortalRenderMode {
+		// each portal renders its destination into its own offscreen framebuffers, which are then sampled as a texture when the portal is drawn
+		PORTAL_RENDER_MODE_FRAMEBUFFER,
+
+		// portal contents are drawn directly into the default framebuffer, masked with the stencil buffer.  each recursion level uses the next stencil reference value, so the maximum depth is limited by the stencil bits requested in Application::initialize
+		PORTAL_RENDER_MODE_STENCIL
+	};
+
+	// what the last occlusion query for a portal found
+	enum PortalOcclusion {
+		// at least part of the portal could be seen, or it hasn't been queried yet
+		PORTAL_OCCLUSION_VISIBLE,
+
+		// the portal was completely hidden behind something else
+		PORTAL_OCCLUSION_HIDDEN,
+
+		// the result hasn't come back from the gpu yet
+		PORTAL_OCCLUSION_PENDING
+	};
+
+	class VisualPortal;
+	class Cell;
+
+	// where a portal is on screen, as found by VisualPortal::getScreenBounds
+	struct PortalScreenBounds {
+		// false if no part of the portal is inside the view frustum
+		bool visible = false;
+
+		// conservative area of the screen covered by the portal
+		Knee::ScreenRect rect;
+
+		// range of NDC depth covered by the visible part of the portal
+		float minDepth = 1;
+		float maxDepth = -1;
+	};
+
+	// a view through a portal, as seen by the camera through any number of other portals
+	// nodes make up a tree built each frame by PortalViewTree, where the children of a node are the portals that can be seen in its pass
+	struct PortalViewNode {
+		// the portal being looked through, NULL for the root (the camera itself)
+		Knee::VisualPortal* portal = NULL;
+
+		// the camera transformation that sees what's on the other side of the portal
+		Knee::GeneralObject cameraTransformation;
+
+		// the cell seen in this node's pass, or NULL if the pass could be seeing anything
+		Knee::Cell* cell = NULL;
+
+		// only objects on these layers are drawn in this node's pass
+		uint32_t layerMask = RENDER_LAYER_ALL;
+
+		// the part of the screen that can be seen through this node, already limited to the bounds of its parent
+		Knee::ScreenRect bounds;
+
+		// NDC depth range the portal covers in its parent's view.  used to prefer closer portals when two cover the same area
+		float minDepth = -1;
+		float maxDepth = 1;
+
+		// how many portals deep this node is, 0 for the root
+		uint32_t depth = 0;
+
+		Knee::PortalViewNode* parent = NULL;
+		std::vector<Knee::PortalViewNode*> children;
+
+		// the portal can see itself in this node's pass, but any deeper levels are warped copies of this pass rather than passes of their own
+		bool reprojectSelf = false;
+
+		// where the pass was rendered in framebuffer mode + the fraction of it that was actually used
+		Knee::Framebuffer2D* framebuffer = NULL;
+		glm::vec2 textureScale = glm::vec2(1);
+
+		// false if the framebuffer was kept from a previous frame, since nothing seen in the pass has changed
+		bool changed = true;
+
+		// rendered with conditional rendering on the occlusion query of a portal seen by the camera, since the query's result wasn't ready yet
+		// the pass may not have actually been drawn, so it can't be cached
+		bool conditional = false;
+
+		// the framebuffer belongs to the PortalTextureCache, so it shouldn't be released once sampled
+		bool cached = false;
+	};
+
 	// a "visual portal" is a surface "paired" to another visual portal.  the portal renders what would be seen through it if light travelled through the pair of portals, or in other words, it "looks" into the paired portal
 	// this effect is only visual, and does not interact with the player
 	class VisualPortal : public RenderableStaticGameObject {
-		// how many times to re-render the world when looking at our own portal
-		// basically, how many portals deep we want an infinite hallway of our own portal to be
-		// higher the number --> greater the performance dip
-		// TODO: add checks to only recursively render if we're positive that we're looking at our own portal
-		// TODO: add checks to limit the amount of objects we have to re-render
-		const static uint32_t RECURSIVE_WORLD_RENDER_COUNT = 16;
+		// default for m_maxRecursionDepth
+		const static uint32_t DEFAULT_MAX_RECURSION_DEPTH = 16;
+
+		// recursion stops once the next level would cover less than this many pixels on screen
+		constexpr static float MIN_RECURSION_PIXEL_AREA = 64.0f;
 
 		// the brightness that the last recurse's portal should have
 		// setting this less than 1 will make the recursively rendered portals progressively darker the further they are from the actual portal
 		// currently disabling this because the effect looks pretty lame and makes the portal teleportation very obvious
 		constexpr static float LAST_RECURSE_BRIGHTNESS = 1.0f;
 
-		// this is the actual brightness that each portal should be rendered with in order for the last portal to have a brightness of LAST_RECURSE_BRIGHTNESS
-		constexpr static float RECURSE_PORTAL_BRIGHTNESS = (float)pow(VisualPortal::LAST_RECURSE_BRIGHTNESS, 1.0 / (double)(VisualPortal::RECURSIVE_WORLD_RENDER_COUNT+1));
+		// each recursion level is rendered at this fraction of the resolution of the level before it
+		constexpr static float RECURSE_RESOLUTION_FALLOFF = 0.8f;
+
+		// render target sizes are rounded up to a multiple of this (in pixels), so that passes with similar bounds can share render targets from the pool
+		// only the part of the render target the pass needs is cleared and rendered to
+		const static uint32_t RENDER_TARGET_SIZE_STEP = 16;
+		const static uint32_t MIN_RENDER_TARGET_SIZE = 16;
+
+		// recursion levels at this depth or deeper are rendered with a lower precision color format when m_useLowPrecisionDeepLevels is set
+		const static uint32_t LOW_PRECISION_RECURSION_LEVEL = 3;
+
+		// recursion levels at this depth or deeper are made by warping the level before them when m_reprojectDeepLevels is set, instead of rendering the scene again
+		const static uint32_t REPROJECTION_RECURSION_LEVEL = 3;
+
+		// a quad clipped against all six clip planes can have at most this many vertices
+		const static uint32_t MAX_CLIPPED_VERTICES = 10;
+
+		// how far the clip plane for a pass is moved from the pair towards the camera, so geometry touching the pair isn't cut off with a visible seam
+		constexpr static float CLIP_PLANE_OFFSET = 0.001f;
+
+		// how many times to re-render the world when looking at our own portal
+		// basically, how many portals deep we want an infinite hallway of our own portal to be
+		// this is only an upper limit, recursion stops early once we can't see ourselves through the pair or we've gotten too small to matter
+		uint32_t m_maxRecursionDepth = DEFAULT_MAX_RECURSION_DEPTH;
 
 		// the paired portal used to determine what the camera should see when viewing this portal.  a paired portal does not have to pair with this portal in order to work
 		// a portal can also pair with itself, which is effectively the same as not existing at all (won't be rendered).  this can be useful for portals that you want to use as an output for another portal but you don't want to pair back (one way hallway sort of effect)
 		Knee::VisualPortal* m_pair = NULL;
 
-		// TODO: it doesn't seem like there's any need to have two framebuffers per portal, might make more sense to have two global framebuffers
-			// however in the future this might make more sense when we have to render other portals through portals, so keeping this for now
-		// framebuffer used for primary rendering
-		Knee::Framebuffer2D* m_mainFramebuffer;
-		
-		// framebuffer used to flip between when rendering ourselves
-		Knee::Framebuffer2D* m_auxFramebuffer;
+		// the cell we're in, NULL if we're in every cell
+		Knee::Cell* m_cell = NULL;
+
+		// how the contents of this portal are rendered
+		Knee::PortalRenderMode m_renderMode = PORTAL_RENDER_MODE_FRAMEBUFFER;
+
+		// maps screen position of the portal to texture coordinates, since the texture only covers the portal's bounds on screen
+		glm::mat3 m_textureTransform = glm::mat3(1);
+
+		// drawn instead of our contents when we have no texture, such as when we've been skipped to stay within the frame's pass budget
+		glm::vec4 m_fallbackColor = glm::vec4(0, 0, 0, 1);
+
+		// handles to the portal shader's own uniforms, looked up again whenever our shader program changes
+		struct PortalUniforms {
+			Knee::RenderableObjectShaderProgram* program = NULL;
+
+			Knee::Uniform<glm::mat3> textureTransform;
+			Knee::Uniform<float> brightness;
+			Knee::Uniform<bool> useFillColor;
+			Knee::Uniform<glm::vec4> fillColor;
+		};
+
+		PortalUniforms m_uniforms;
+
+		const PortalUniforms& getUniforms();
+
+		// any samples passed query, drawn against the main view's depth each frame
+		// the result is used the frame after, so that we never have to wait on the gpu for it
+		uint32_t m_occlusionQuery = 0;
+		bool m_occlusionQueryIssued = false;
+
+		// render deep recursion levels with a 16 bit color format
+		// falls back to the default format if the driver can't render to it
+		bool m_useLowPrecisionDeepLevels = true;
+
+		// synthesize deep recursion levels by warping the last real level through the homography between where we appear in it and where we appear in the level before it
+		// this is only exact for scenes that look the same from every level (like an infinite hallway), but costs a copy + a single quad per level rather than a full scene pass
+		// only used in framebuffer mode
+		bool m_reprojectDeepLevels = false;
+
+		// whether what can be seen through us is drawn by renderPortalStencil in the stencil pass currently being drawn.  if not, we're drawn with our fallback color
+		// left set outside of PortalViewTree::renderPortalsStencil, so that we draw nothing while the main view is drawn
+		bool m_hasStencilNode = true;
+
+		protected:
+			// size of the area actually rendered to for a pass whose bounds cover the given amount of pixels on screen
+			uint32_t getPassDimension(float pixels, uint32_t recursionLevel);
+
+			// size + format of the render target used for a pass.  the render target can be bigger than the pass, in which case the pass is scissored to the part it uses
+			uint32_t getRenderTargetDimension(uint32_t passDimension);
+			GLenum getRenderTargetFormat(uint32_t recursionLevel);
+
+			// get the plane of our pair facing away from a camera that has been moved into pair space, used to clip everything between the camera and the pair
+			glm::vec4 getPassClipPlane(Knee::Camera* camera);
+
+			// draws the portal surface into the stencil buffer, incrementing the stencil value from recursionLevel to recursionLevel+1 wherever the portal is visible
+			void markStencil(uint32_t recursionLevel);
+
+			// fills the portal's stencil region with the fill color and resets depth within it to the far plane
+			void clearStencilRegion(uint32_t recursionLevel);
+
+			// writes the portal surface's depth and decrements the stencil value from recursionLevel+1 back to recursionLevel
+			void unmarkStencil(uint32_t recursionLevel);
 
 		public:
-			VisualPortal(Knee::VertexData* vertexData, uint32_t screenWidth, uint32_t screenHeight);
+			VisualPortal(Knee::VertexData* vertexData);
 			~VisualPortal();
 
 			Knee::RenderableStaticGameObject* asRenderableStaticGameObject();
 
 			// pair another portal with this portal.  can pass self in order to create a blank portal
 			void pair(Knee::VisualPortal* portal);
+			Knee::VisualPortal* getPair();
 
 			// get the transformation required to move any object from their current position relative to this portal to the same position relative to the paired portal
 			Knee::GeneralObject getPairSpaceTransformation();
 
 			void getVertices(glm::vec3& topLeft, glm::vec3& topRight, glm::vec3& bottomLeft, glm::vec3& bottomRight);
-			bool isVisible(Knee::PerspectiveCamera* camera);
 
-			void loadPortalTexture(std::vector<RenderableObject*>* renderableObjects, Knee::RenderableObjectShaderProgram* renderableObjectShaderProgramWithDepth);
+			// get the corners of every portal in order around their edges, four per portal, for use with getScreenBounds
+			static void getCorners(const std::vector<Knee::VisualPortal*>& portals, std::vector<glm::vec3>& corners);
+
+			// find where every portal is on screen when viewed with the given matrix, one result per four corners
+			// each portal is clipped against the view frustum, so the results are exact for the visible part of the portal even when some of it is behind the camera
+			static void getScreenBounds(glm::mat4 viewProjection, const std::vector<glm::vec3>& corners, std::vector<Knee::PortalScreenBounds>& bounds);
+
+			// collects every object which needs to be drawn in the pass for a node of the view tree whose portal is this one
+			void getPassObjects(Knee::PortalViewNode* node, std::vector<RenderableObject*>* renderableObjects, Knee::DrawList* drawList, std::vector<RenderableObject*>& passObjects);
+
+			// get the volume that can be seen through our pair by a camera that has been moved into pair space
+			// this is the camera's own frustum narrowed to the pair's opening, with everything between the camera and the pair cut off
+			Knee::Frustum getPassFrustum(Knee::Camera* camera);
+
+			// the brightness that each portal should be rendered with in order for the last portal to have a brightness of LAST_RECURSE_BRIGHTNESS
+			float getRecursePortalBrightness();
+
+			// whether a level covering the given bounds is big enough on screen to be worth rendering
+			static bool isRecursionVisible(const Knee::ScreenRect& bounds, uint32_t screenWidth, uint32_t screenHeight);
+
+			// scales texture coordinates to account for only part of a render target being used
+			static glm::mat3 getTextureScaleMatrix(glm::vec2 scale);
+
+			// signed distance of a clip space vertex to one of the six clip planes, in the order -x, +x, -y, +y, -z, +z.  positive is inside
+			static float getClipPlaneDistance(const glm::vec4& v, uint32_t plane);
+
+			// clips a polygon in clip space against the clip planes with their bit set in planes, returning the new vertex count
+			// polygon needs room for MAX_CLIPPED_VERTICES
+			static uint32_t clipPolygon(glm::vec4 polygon[], uint32_t vertexCount, uint32_t planes);
+
+			// where our corners are in NDC when viewed with the given matrix.  returns false if any are behind the camera
+			bool getScreenQuad(glm::mat4 viewProjection, glm::vec2 quad[4]);
+
+			// area of a quad in NDC, in pixels on a screen with the given size
+			static float getQuadPixelArea(const glm::vec2 quad[4], uint32_t screenWidth, uint32_t screenHeight);
+
+			// renders the pass for a node of the view tree whose portal is this one, drawing the objects from getPassObjects
+			// the render target is taken from framebufferPool and stored in the node, and stays in use until it's released by the tree or the pool's frame ends
+			void loadPortalTexture(Knee::PortalViewNode* node, const std::vector<RenderableObject*>& passObjects, Knee::DrawList* drawList, Knee::FramebufferPool* framebufferPool, uint32_t screenWidth, uint32_t screenHeight);
+
+			// draws our surface into an occlusion query against the depth currently in the framebuffer, without changing color or depth
+			void queryOcclusion();
+
+			// forget the last occlusion query, so that we're treated as visible until the next one
+			// for when the query wasn't made against a view that covered us, so its result says nothing
+			void clearOcclusion();
+
+			// the result of the last occlusion query, without waiting on it
+			Knee::PortalOcclusion getOcclusion();
+			uint32_t getOcclusionQuery();
+
+			// whether a view of ourselves at the given recursion level is made by warping the level before it rather than being rendered
+			bool reprojectsRecursionLevel(uint32_t recursionLevel);
+
+			// adds warped copies of the node's pass inside of itself, for as many levels as are visible and allowed by our max depth
+			// expects loadPortalTexture to have just been called for the node, since it relies on the depth the pass left in the pool's shared renderbuffer
+			void reprojectPortalTexture(Knee::PortalViewNode* node, Knee::FramebufferPool* framebufferPool, uint32_t screenWidth, uint32_t screenHeight);
+
+			// the texture to show, along with the transformation from screen position to texture coordinates.  NULL shows the fallback color
+			void setPortalTexture(Knee::Texture2D* texture, glm::mat3 textureTransform);
+
+			// renders what can be seen through this portal for a node of the view tree straight into the current framebuffer, inside the region of the stencil buffer equal to the node's recursion level, then does the same for the node's children
+			// everything we draw is scissored to the node's bounds
+			// expects the stencil + scissor tests to be enabled and the camera to be at the transformation of the node's parent
+			void renderPortalStencil(Knee::PortalViewNode* node, std::vector<Knee::VisualPortal*>* portals, std::vector<RenderableObject*>* renderableObjects, Knee::DrawList* drawList, uint32_t screenWidth, uint32_t screenHeight);
+
+			// set by PortalViewTree::setStencilNodes before each stencil pass is drawn
+			void setHasStencilNode(bool hasStencilNode);
+
+			// set the gl scissor box to a rectangle snapped to pixels
+			static void setScissor(const Knee::ScreenRect& bounds, uint32_t screenWidth, uint32_t screenHeight);
+
+			Knee::PortalRenderMode getRenderMode();
+			void setRenderMode(Knee::PortalRenderMode renderMode);
+
+			// portals set their own texture uniforms
+			bool hasCustomDraw();
 
 			void draw();
 
 			bool hasPair();
 			bool isOwnPair();
 
+			// set by Cell::addVisualPortal
+			Knee::Cell* getCell();
+			void setCell(Knee::Cell* cell);
+
 			void setBrightness(float brightness);
+
+			void setLowPrecisionDeepLevels(bool useLowPrecision);
+			void setReprojectDeepLevels(bool reproject);
+
+			// in stencil mode the depth is also limited by the stencil bits requested in Application::initialize
+			uint32_t getMaxRecursionDepth();
+			void setMaxRecursionDepth(uint32_t maxRecursionDepth);
+
+			// when enabled, the portal is drawn with a flat color rather than its texture
+			void setFillColor(bool useFillColor, glm::vec4 color = glm::vec4(0));
+
+			void setFallbackColor(glm::vec4 color);
 	};
 
 	class Portal : public VisualPortal {
@@ -65,7 +322,7 @@ namespace Knee {
 		Portal* m_pair = NULL;
 
 		public:
-			Portal(Knee::VertexData* vertexData, uint32_t screenWidth, uint32_t screenHeight);
+			Portal(Knee::VertexData* vertexData);
 
 			// return self as a visual portal
 			VisualPortal* asVisualPortal();
@@ -76,4 +333,149 @@ namespace Knee {
 			// check if we need to move the player through this portal
 			bool checkPlayer(Knee::Player* player, double delta);
 	};
+
+	// render targets for views through portals from previous frames, so that views which haven't changed don't need to be rendered again
+	// views are identified by the portals they're seen through starting from the camera.  once the render targets take up more memory than allowed, the least recently used are dropped
+	class PortalTextureCache {
+		// default for m_maxBytes
+		const static size_t DEFAULT_MAX_BYTES = 64 * 1024 * 1024;
+
+		struct CachedTexture {
+			Knee::Framebuffer2D* framebuffer;
+			glm::vec2 textureScale;
+
+			// everything the view was rendered with
+			// the pass's resolution follows from its bounds and the screen size
+			Knee::GeneralObject cameraTransformation;
+			glm::mat4 projectionMatrix;
+			uint32_t screenWidth;
+			uint32_t screenHeight;
+			Knee::ScreenRect bounds;
+			bool reprojectSelf;
+			std::vector<Knee::VisualPortal*> childPortals;
+			std::vector<Knee::RenderableObject*> passObjects;
+
+			// the latest transform version when the view was rendered, anything newer has moved since
+			uint64_t transformVersion;
+
+			// frame the texture was last used in
+			uint64_t lastUsedFrame;
+
+			// approximate size of the render target
+			size_t bytes;
+		};
+
+		std::map<std::vector<Knee::VisualPortal*>, CachedTexture> m_textures;
+
+		// the most memory render targets in the cache can take up
+		size_t m_maxBytes = DEFAULT_MAX_BYTES;
+		size_t m_bytes = 0;
+
+		uint64_t m_frame = 0;
+
+		// the portals the node is seen through, starting from the camera
+		static std::vector<Knee::VisualPortal*> getPath(Knee::PortalViewNode* node);
+
+		// approximate memory used by a render target
+		static size_t getFramebufferBytes(Knee::Framebuffer2D* framebuffer);
+
+		// drops textures not used this frame, least recently used first, until bytes more can fit.  returns false if they can't
+		bool makeRoom(size_t bytes, Knee::FramebufferPool* framebufferPool);
+
+		void remove(std::map<std::vector<Knee::VisualPortal*>, CachedTexture>::iterator it, Knee::FramebufferPool* framebufferPool);
+
+		public:
+			// call before looking anything up for a new frame
+			void beginFrame();
+
+			// gives the node its render target from a previous frame if nothing in it has changed.  passObjects are what would be drawn in the node's pass this frame
+			// expects the node's children to have been loaded already
+			bool fetch(Knee::PortalViewNode* node, const std::vector<RenderableObject*>& passObjects, Knee::FramebufferPool* framebufferPool, uint32_t screenWidth, uint32_t screenHeight);
+
+			// keep the render target the node was just rendered to for later frames, if there's room
+			void store(Knee::PortalViewNode* node, const std::vector<RenderableObject*>& passObjects, Knee::FramebufferPool* framebufferPool, uint32_t screenWidth, uint32_t screenHeight);
+
+			// gives every render target back to the pool
+			void clear(Knee::FramebufferPool* framebufferPool);
+
+			size_t getMaxBytes();
+			void setMaxBytes(size_t maxBytes);
+			size_t getByteCount();
+	};
+
+	// every view through a portal that will be rendered this frame, including views through portals seen through other portals
+	// built each frame from the camera by always expanding whichever view covers the most of the screen next, until the pass budget runs out.  portals that don't make it are drawn with their fallback color
+	class PortalViewTree {
+		// default for m_passBudget
+		const static uint32_t DEFAULT_PASS_BUDGET = 32;
+
+		// in stencil mode a node's depth is its stencil value, which can't go past what the 8 stencil bits requested in Application::initialize hold
+		const static uint32_t MAX_STENCIL_DEPTH = 255;
+
+		// every node for the current frame.  a deque so that pointers to nodes stay valid as more are added
+		std::deque<Knee::PortalViewNode> m_nodes;
+
+		// the camera itself, which everything else is seen from
+		Knee::PortalViewNode* m_root = NULL;
+
+		// the most scene passes that can be rendered through portals in a frame
+		uint32_t m_passBudget = DEFAULT_PASS_BUDGET;
+		uint32_t m_passCount = 0;
+
+		// passes that are still valid from previous frames
+		Knee::PortalTextureCache m_textureCache;
+
+		// layers drawn in passes through portals.  the main view's are given to build
+		uint32_t m_layerMask = RENDER_LAYER_ALL;
+
+		// corners of every portal, which don't move while the tree is being built
+		std::vector<glm::vec3> m_portalCorners;
+
+		// where every portal is in the view currently having candidates added
+		std::vector<Knee::PortalScreenBounds> m_portalScreenBounds;
+
+		// adds a candidate node for every portal that can be seen in the parent's pass
+		void addCandidates(Knee::PortalViewNode* parent, Knee::Camera* camera, std::vector<Knee::VisualPortal*>* portals, std::vector<Knee::PortalViewNode*>& candidates, uint32_t screenWidth, uint32_t screenHeight);
+
+		// orders candidates by how much of the screen they cover
+		static bool compareCoverage(Knee::PortalViewNode* a, Knee::PortalViewNode* b);
+
+		// renders the node's children, and then the node itself
+		void loadNodeTexture(Knee::PortalViewNode* node, std::vector<Knee::VisualPortal*>* portals, std::vector<RenderableObject*>* renderableObjects, Knee::DrawList* drawList, Knee::FramebufferPool* framebufferPool, uint32_t screenWidth, uint32_t screenHeight);
+
+		// gives every portal the texture it should show in the node's pass
+		void setPortalTextures(Knee::PortalViewNode* node, std::vector<Knee::VisualPortal*>* portals);
+
+		public:
+			// rebuild the tree for the camera's current position
+			// if the camera's cell is given, each pass only sees the portals in the cell of the pair it's looking through
+			// layerMask is the layers drawn in the main view, which decides which portals it can see
+			void build(Knee::Camera* camera, Knee::Cell* cell, uint32_t layerMask, std::vector<Knee::VisualPortal*>* portals, uint32_t screenWidth, uint32_t screenHeight);
+
+			// renders every pass into render targets from the pool, deepest first, and leaves each portal with its texture for the main view
+			void loadPortalTextures(std::vector<Knee::VisualPortal*>* portals, std::vector<RenderableObject*>* renderableObjects, Knee::DrawList* drawList, Knee::FramebufferPool* framebufferPool, uint32_t screenWidth, uint32_t screenHeight);
+
+			// renders every pass straight into the current framebuffer using the stencil buffer
+			// portals in the main view without a node are filled with their fallback color first, since the main view is drawn before the tree is built
+			// expects the stencil + scissor tests to be enabled, and the main view to have been drawn at stencil level 0
+			void renderPortalsStencil(std::vector<Knee::VisualPortal*>* portals, std::vector<RenderableObject*>* renderableObjects, Knee::DrawList* drawList, uint32_t screenWidth, uint32_t screenHeight);
+
+			// tells every portal whether it has a node of its own in the node's pass
+			static void setStencilNodes(Knee::PortalViewNode* node, std::vector<Knee::VisualPortal*>* portals);
+
+			// what the node's pass could see, which is everything given unless the node knows which cell it's looking into
+			static std::vector<RenderableObject*>* getNodeObjects(Knee::PortalViewNode* node, std::vector<RenderableObject*>* renderableObjects);
+
+			Knee::PortalViewNode* getRoot();
+			Knee::PortalTextureCache* getTextureCache();
+
+			// how many passes the tree has, never more than the budget
+			uint32_t getPassCount();
+
+			uint32_t getPassBudget();
+			void setPassBudget(uint32_t passBudget);
+
+			uint32_t getLayerMask();
+			void setLayerMask(uint32_t layerMask);
+	};
 }
\ No newline at end of file
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+namespace Knee {
+	// draws for one pass, each packed into a 64 bit key so that sorting the keys groups draws that share state and orders the rest front to back
+	// from the most significant bit down, a key is:
+	//  layer (5 bits) - lowest layer the object is on, so layers are drawn in order
+	//  custom (1 bit) - set for objects that draw themselves, which go after everything that can share state
+	//  program (10 bits), texture (12 bits), vertex array (12 bits) - gl names, cut down to fit.  names that collide only cost an extra state change
+	//  depth (24 bits) - distance from the camera as a fraction of the far plane
+	class RenderQueue {
+		const static uint32_t LAYER_BITS = 5;
+		const static uint32_t CUSTOM_BITS = 1;
+		const static uint32_t PROGRAM_BITS = 10;
+		const static uint32_t TEXTURE_BITS = 12;
+		const static uint32_t VERTEX_ARRAY_BITS = 12;
+		const static uint32_t DEPTH_BITS = 24;
+
+		// keys are sorted one byte at a time
+		const static uint32_t RADIX_BITS = 8;
+		const static uint32_t RADIX_SIZE = 1 << RADIX_BITS;
+		const static uint32_t RADIX_PASSES = 64 / RADIX_BITS;
+
+		struct Packet {
+			uint64_t key;
+
+			// whatever the caller uses to find what to draw, usually an index into its own list
+			uint32_t index;
+		};
+
+		std::vector<Knee::RenderQueue::Packet> m_packets;
+
+		// where packets go between radix passes
+		std::vector<Knee::RenderQueue::Packet> m_sortBuffer;
+
+		public:
+			RenderQueue();
+
+			static uint64_t makeKey(uint32_t layer, bool custom, uint32_t program, uint32_t texture, uint32_t vertexArray, float depth);
+
+			void clear();
+			void push(uint64_t key, uint32_t index);
+
+			// stable least significant digit radix sort, skipping bytes that are the same in every key
+			void sort();
+
+			uint32_t getSize();
+			uint64_t getKey(uint32_t i);
+			uint32_t getIndex(uint32_t i);
+	};
+}
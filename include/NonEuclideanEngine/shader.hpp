@@ -12,14 +12,29 @@
 #include <glm/ext.hpp>
 
 namespace Knee {
+	// smaller formats VertexData can store attributes in instead of 32 bit floats, combined as flags and picked per mesh
+	// anything that a mesh can't be stored in is left as floats
+	enum VertexPacking : uint32_t {
+		VERTEX_PACKING_NONE = 0,
+
+		// 16 bit floats.  positions are only precise to about a thousandth of their distance from the origin, so this is for meshes that are small in model space
+		VERTEX_PACKING_HALF_POSITIONS = 1 << 0,
+		VERTEX_PACKING_HALF_TEXCOORDS = 1 << 1,
+
+		// 16 bit normalized integers, more precise than half floats but only for texture coordinates that are all between 0 and 1
+		// takes priority over VERTEX_PACKING_HALF_TEXCOORDS, which is used instead if both are set and the coordinates don't fit
+		VERTEX_PACKING_UNORM16_TEXCOORDS = 1 << 2,
+
+		// 10 bits per axis, as GL_INT_2_10_10_10_REV
+		VERTEX_PACKING_PACKED_NORMALS = 1 << 3,
+
+		VERTEX_PACKING_ALL = VERTEX_PACKING_HALF_POSITIONS | VERTEX_PACKING_HALF_TEXCOORDS | VERTEX_PACKING_UNORM16_TEXCOORDS | VERTEX_PACKING_PACKED_NORMALS
+	};
+
 	// class containing basic vertex data for a model.  allows for positions, texture coordinates, and normals in any format.  note that for general safety, the copy constructor for the class is disabled to prevent situations where two VertexData objects point to the same vbo and vao, leading to a bad situation if one were to delete one of the copies and not the other.
 	// any method that requires VertexData will take it as a const reference
 	class VertexData {
 		// vertex attribute constants
-		static const std::string VA_POSITION_STR;
-		static const std::string VA_TEXCOORD_STR;
-		static const std::string VA_NORMAL_STR;
-		
 		static const uint32_t VA_POSITION_SIZE;
 		static const uint32_t VA_TEXCOORD_SIZE;
 		static const uint32_t VA_NORMAL_SIZE;
@@ -27,6 +42,19 @@ namespace Knee {
 		static const uint32_t VA_POSITION_INDEX;
 		static const uint32_t VA_TEXCOORD_INDEX;
 		static const uint32_t VA_NORMAL_INDEX;
+
+		// how one attribute is stored in the vertex buffer
+		struct AttributeFormat {
+			GLuint index = 0;
+
+			GLenum type = GL_FLOAT;
+			GLint size = 0;
+			GLboolean normalized = GL_FALSE;
+
+			// where the attribute is in each vertex, in floats for the unpacked data + in bytes for the buffer
+			uint32_t floatOffset = 0;
+			uint32_t byteOffset = 0;
+		};
 		
 		
 		// vertex buffer object
@@ -34,12 +62,65 @@ namespace Knee {
 		
 		// vertex array object
 		GLuint m_vao;
+
+		// element buffer object, which the vao keeps bound
+		GLuint m_ebo;
 		
-		// number of vertices
+		// number of (distinct) vertices
 		uint32_t m_vertexCount;
+
+		// number of indices drawn, 3 per triangle.  indices are 16 bit if every vertex can be reached with them, otherwise 32
+		uint32_t m_indexCount = 0;
+		GLenum m_indexType = GL_UNSIGNED_INT;
+
+		// layout of each vertex, as passed in.  stride is in floats
+		std::string m_attributeOrder;
+		uint32_t m_stride = 0;
+
+		// how the vertices are actually stored, which is what was asked for minus anything they didn't fit in
+		uint32_t m_packing = VERTEX_PACKING_NONE;
+		std::vector<Knee::VertexData::AttributeFormat> m_attributeFormats;
+
+		// bytes per vertex in the vertex buffer, always a multiple of 4
+		uint32_t m_vertexSize = 0;
+
+		// sphere containing every vertex position, in model space
+		// radius is infinite if there are no positions
+		glm::vec3 m_boundingCenter = glm::vec3(0);
+		float m_boundingRadius = 0.0f;
+
+		// simplified copies of this data, each with about half the triangles of the one before it, along with how far each one's surface strays from ours (in model units)
+		std::vector<Knee::VertexData*> m_lods;
+		std::vector<float> m_lodErrors;
+
+		// a level of detail is used once its error would cover less than this many pixels on screen
+		constexpr static float MAX_LOD_PIXEL_ERROR = 1.0f;
+
+		// floats per vertex with the attribute order
+		static uint32_t getAttributeOrderStride(std::string attributeOrder);
+
+		// optimize the order of the triangles + vertices, then upload them packed
+		void create(std::vector<float>& vertices, std::vector<uint32_t>& indices, uint32_t packing);
+
+		// lay out the attributes with whichever of the packing the vertices fit in
+		void setAttributeFormats(const std::vector<float>& vertices, uint32_t packing);
+
+		static void packAttribute(const Knee::VertexData::AttributeFormat& format, const float* in, uint8_t* out);
+		static void unpackAttribute(const Knee::VertexData::AttributeFormat& format, const uint8_t* in, float* out);
 		
 		public:
-			VertexData(float*, uint32_t, GLsizeiptr, std::string);
+			// characters used for each attribute in an attribute order
+			static const std::string VA_POSITION_STR;
+			static const std::string VA_TEXCOORD_STR;
+			static const std::string VA_NORMAL_STR;
+
+			// the data is a list of triangles, with identical vertices stored once + drawn through indices
+			// also generates up to lodCount simplified levels of detail from the data (which needs positions for that), stored with the same packing (VertexPacking flags)
+			VertexData(float*, uint32_t, GLsizeiptr, std::string, uint32_t lodCount = 0, uint32_t packing = VERTEX_PACKING_NONE);
+
+			// the data is already indexed, with 3 indices into its vertices per triangle
+			VertexData(float*, uint32_t, GLsizeiptr, std::string, const std::vector<uint32_t>& indices, uint32_t packing = VERTEX_PACKING_NONE);
+
 			~VertexData();
 			
 			// disable copy constructor and assignment operator
@@ -47,11 +128,56 @@ namespace Knee {
 			VertexData& operator=(VertexData const&) = delete;
 			
 			uint32_t getVertexCount() const ;
+
+			uint32_t getIndexCount() const ;
+			GLenum getIndexType() const ;
+
+			glm::vec3 getBoundingCenter() const ;
+			float getBoundingRadius() const ;
+
+			uint32_t getLODCount() const ;
+
+			// the simplest level of detail that still looks the same when one model unit covers pixelsPerUnit pixels on screen
+			const Knee::VertexData* getLOD(float pixelsPerUnit) const ;
+
+			GLuint getGLVertexArray() const ;
+
+			std::string getAttributeOrder() const ;
+			uint32_t getStride() const ;
+
+			uint32_t getPacking() const ;
+			uint32_t getVertexSize() const ;
+
+			// where the attribute (VA_*_STR) starts in each vertex in floats, or -1 if the data doesn't have it
+			int32_t getAttributeOffset(std::string attribute) const ;
+
+			// read the vertices back from the gpu, since no copy of them is kept.  packed attributes are unpacked back to floats
+			// slow, so only for things done once like baking static batches
+			void readData(std::vector<float>& data) const ;
+			void readIndices(std::vector<uint32_t>& indices) const ;
 			
 			void use() const;
 	};
 	
+	// a uniform in a ShaderProgram, looked up once by name after the program is compiled
+	// handles to uniforms that the program doesn't have can still be set, it just does nothing
+	template<typename T>
+	struct Uniform {
+		int32_t slot = -1;
+
+		bool exists() const { return this->slot >= 0; }
+	};
+
 	class ShaderProgram {
+		// a uniform's location + the last value set to it in this program, so that setting the same value again doesn't reach the driver
+		struct UniformSlot {
+			GLint location = -1;
+
+			// big enough for a mat4
+			float value[16];
+			bool hasValue = false;
+		};
+
 		// PRIVATE MEMBERS //
 		static int32_t MAX_TEXTURE_UNITS; // maximum supported texture units (implementation dependent)
 		
@@ -62,8 +188,9 @@ namespace Knee {
 		// shader management
 		std::vector<GLuint> m_shaders;
 		
-		// uniform management
-		std::map<std::string, GLint> m_uniforms;
+		// uniform management, from names to slots in m_uniformSlots
+		std::map<std::string, uint32_t> m_uniforms;
+		std::vector<Knee::ShaderProgram::UniformSlot> m_uniformSlots;
 
 		// amount of textures bound currently
 		uint32_t m_boundTextureCount;
@@ -73,24 +200,56 @@ namespace Knee {
 			GLchar* getProgramInfoLog();
 			
 			void markAttachedShadersForDeletion();
+
+			// -1 if the program has no uniform with the name
+			int32_t getUniformSlot(std::string name);
+
+			// copy the value into the slot's shadow, returning false if it was already there and the uniform doesn't need to be set
+			bool updateUniformValue(int32_t slot, const void* value, size_t size);
+
+			// called once the program is compiled, for subclasses to look up the handles they use
+			virtual void loadUniforms();
 		public:
 			ShaderProgram();
-			~ShaderProgram();
+			virtual ~ShaderProgram();
 			
 			static void loadMaxTextureUnits();
 			uint32_t getMaxTextureUnits();
 			
 			void bindTexture2D(std::string, Knee::Texture2D*);
+			void bindTexture2D(const Knee::Uniform<GLint>& sampler, Knee::Texture2D*);
 			void resetBoundTextures();
 
 			bool isCompiled();
+			GLuint getGLProgram();
 			GLint getUniformLocation(std::string);
 			
 			// returns 0 upon success and -1 upon error
 			int32_t attachShader(GLenum, std::string);
 			int32_t loadUniformLocations();
 			
+			bool setUniformMat3(std::string, glm::mat3);
 			bool setUniformMat4(std::string, glm::mat4);
+
+			// look up a uniform to set with setUniform
+			template<typename T>
+			Knee::Uniform<T> getUniform(std::string name){
+				Knee::Uniform<T> uniform;
+				uniform.slot = this->getUniformSlot(name);
+
+				return uniform;
+			}
+
+			// only reaches the driver if the value is different from what the uniform was last set to
+			void setUniform(const Knee::Uniform<GLint>&, GLint);
+			void setUniform(const Knee::Uniform<bool>&, bool);
+			void setUniform(const Knee::Uniform<float>&, float);
+			void setUniform(const Knee::Uniform<glm::vec4>&, glm::vec4);
+			void setUniform(const Knee::Uniform<glm::mat3>&, const glm::mat3&);
+			void setUniform(const Knee::Uniform<glm::mat4>&, const glm::mat4&);
+
+			// point a uniform block in this shader at a uniform buffer binding.  returns true if the block was found, false if otherwise.
+			bool setUniformBlockBinding(std::string, GLuint);
 			
 			int32_t compile();
 			void destroy();
@@ -98,6 +257,11 @@ namespace Knee {
 			void use();
 			
 			void drawArrays(uint32_t);
+
+			// draw the vertex data's triangles through its indices, expecting it to be in use already
+			void drawElements(const Knee::VertexData*);
+			void drawElementsInstanced(const Knee::VertexData*, uint32_t instanceCount);
+
 			void drawVertexData(const Knee::VertexData*);
 	};
 	
@@ -107,6 +271,25 @@ namespace Knee {
 		// (m_projectionMatrix * m_viewMatrix)
 		glm::mat4 m_vpMatrix = glm::mat4(1);
 
+		// the projection that m_vpMatrix was actually made with, including the crop and clip plane
+		glm::mat4 m_renderProjectionMatrix = glm::mat4(1);
+
+		// incremented whenever m_vpMatrix is updated, so that anything copied from the camera knows when it's out of date
+		uint64_t m_version = 0;
+
+		// applied after projection to stretch part of the screen over the whole viewport, used when rendering into a render target that only covers that part
+		glm::mat4 m_cropMatrix = glm::mat4(1);
+
+		// world space plane (normal, -dot(normal, point)) used in place of the near plane when m_useClipPlane is set.  only what's on the positive side is drawn
+		glm::vec4 m_clipPlane = glm::vec4(0);
+		bool m_useClipPlane = false;
+
+		// clip planes closer to the camera than this are ignored
+		static const float MIN_CLIP_PLANE_DISTANCE;
+
+		// height of whatever is being rendered to, used to pick levels of detail.  0 if unknown, in which case everything is drawn in full detail
+		float m_viewportHeight = 0.0f;
+
 		protected:
 			// a copy of the matrices used to transform m_vpMatrix.  they're only used internally as a reference if the other is changed, but generally m_vpMatrix will be used for shaders so that the matrix multiplication of projection * view doesn't have to be done more than once per frame (unless necessary)
 			// projection matrix is public here because subclasses are expected to mess with it a bit, but not so much the view matrix.
@@ -121,6 +304,9 @@ namespace Knee {
 			glm::mat4 getProjectionMatrix();
 			glm::mat4 getViewMatrix();
 			glm::mat4 getViewProjectionMatrix();
+			glm::mat4 getRenderProjectionMatrix();
+
+			uint64_t getVersion();
 			
 			// update view matrix based on the current values of m_position and m_rotation
 			void updateViewMatrix();
@@ -131,6 +317,27 @@ namespace Knee {
 
 			void setPosition(glm::vec3 position);
 			void setRotation(glm::vec3 rotation);
+
+			// only render the given part of the screen, stretched to fill the viewport
+			// takes effect on the next call to updateViewProjectionMatrix
+			void setCrop(const Knee::ScreenRect& crop);
+			void resetCrop();
+
+			// replace the near plane with the given world space plane (oblique frustum), so anything on its negative side is clipped
+			// the camera must be on the negative side of the plane.  takes effect on the next call to updateViewProjectionMatrix
+			void setClipPlane(glm::vec4 plane);
+			void resetClipPlane();
+			bool hasClipPlane();
+			glm::vec4 getClipPlane();
+
+			void setViewportHeight(float viewportHeight);
+			float getViewportHeight();
+
+			// how many pixels tall one world unit would be on screen at the closest point of a sphere, which is infinite if the sphere reaches the camera
+			float getPixelsPerUnit(glm::vec3 center, float radius);
+
+			// returns the projection matrix with the near plane replaced by the view space plane
+			static glm::mat4 getObliqueProjectionMatrix(glm::mat4 projection, glm::vec4 viewSpacePlane);
 	};
 	
 	class PerspectiveCamera : public Camera {
@@ -139,8 +346,36 @@ namespace Knee {
 		float m_fov = 0.0;
 		float m_aspectRatio = 0.0;
 
+		// matches the std140 layout of the Camera uniform block in the shaders
+		struct UniformBlock {
+			glm::mat4 view;
+			glm::mat4 projection;
+			glm::mat4 viewProjection;
+
+			// w is 1
+			glm::vec4 position;
+
+			// near, far, 0, 0
+			glm::vec4 depthRange;
+		};
+
+		// uniform buffer holding a copy of the camera, created on first use so that we don't need a gl context to construct a camera
+		GLuint m_uniformBuffer = 0;
+
+		// the version of the camera that was last copied to m_uniformBuffer
+		uint64_t m_uniformVersion = 0;
+
 		public:
+			// name + binding point of the uniform block that shaders read the camera from
+			static const std::string UNIFORM_BLOCK_NAME;
+			static const GLuint UNIFORM_BLOCK_BINDING;
+
 			PerspectiveCamera();
+			~PerspectiveCamera();
+
+			// disable copy constructor and assignment operator, since copies would share the uniform buffer
+			PerspectiveCamera(const PerspectiveCamera&) = delete;
+			PerspectiveCamera& operator=(PerspectiveCamera const&) = delete;
 			
 			float getNear();
 			float getFar();
@@ -149,11 +384,28 @@ namespace Knee {
 
 			// automatically calls updateViewProjectionMatrix()
 			void setPerspectiveProperties(float fov, float aspectRatio, float near, float far);
+
+			// bind the camera's uniform buffer for all shader calls following, copying the camera into it first if it has changed since the last time
+			void useUniformBuffer();
 	};
 	
+	// uniforms that RenderableObjects + DrawList set, any of which a shader can leave out
+	struct RenderableObjectUniforms {
+		Knee::Uniform<glm::mat4> model;
+		Knee::Uniform<GLint> instanceBase;
+		Knee::Uniform<GLint> instanceObjects;
+		Knee::Uniform<GLint> objectTransforms;
+		Knee::Uniform<GLint> sampler;
+	};
+
 	// class for rendering RenderableObjects, rendered with perspective projection from the viewpoint of a camera.
 	class RenderableObjectShaderProgram : public ShaderProgram {
 		Knee::PerspectiveCamera* m_camera;
+
+		Knee::RenderableObjectUniforms m_uniformHandles;
+
+		protected:
+			void loadUniforms() override;
 		
 		public:
 			RenderableObjectShaderProgram(float fov, float aspectRatio, float near, float far);
@@ -162,8 +414,20 @@ namespace Knee {
 			RenderableObjectShaderProgram(Knee::PerspectiveCamera* camera);
 
 			Knee::PerspectiveCamera* getCamera();
+
+			const Knee::RenderableObjectUniforms& getUniforms();
+	};
+
+	// layers that objects can be put on, one bit each.  any other bits are free to be used for whatever layers a game needs
+	enum RenderLayer : uint32_t {
+		RENDER_LAYER_DEFAULT = 1 << 0,
+
+		// mask for passes that draw every layer
+		RENDER_LAYER_ALL = 0xFFFFFFFF
 	};
 
+	class DrawList;
+
 	// abstract class defining RenderableObjects and their properties.  Any object that you want to be renderable by a RenderableObjectShaderProgram should inherit from this class and overload the appropriate methods.
 	class RenderableObject : public virtual GeneralObject {
 		// vertex data to be used when rendering
@@ -172,10 +436,34 @@ namespace Knee {
 		// shader program to use when rendering
 		RenderableObjectShaderProgram* m_shaderProgram;
 
+		// the layers the object is on.  a pass only draws objects that are on at least one of the layers in its own mask
+		uint32_t m_layerMask = RENDER_LAYER_DEFAULT;
+
+		// the object isn't drawn in portal passes deeper than this, so 0 is only drawn in the main view
+		uint32_t m_maxPortalDepth = UNLIMITED_PORTAL_DEPTH;
+
+		// the newest version handed out to any object
+		static uint64_t LATEST_RENDER_STATE_VERSION;
+
+		// changes every time the program, texture, layers, or max portal depth change, and is always newer than any version handed out before
+		uint64_t m_renderStateVersion = 0;
+
+		// every change goes through here
+		void updateRenderStateVersion();
+
+		// where the object was compiled into a DrawList, valid only for the frame the list was on at the time
+		uint64_t m_drawFrame = 0;
+		uint32_t m_drawIndex = 0;
+
+		friend class DrawList;
+
 		protected:
 			// texture to be used when rendering
 			Knee::Texture2D* m_texture;
 		public:
+			// default for m_maxPortalDepth, drawn through any number of portals
+			const static uint32_t UNLIMITED_PORTAL_DEPTH = 0xFFFFFFFF;
+
 			RenderableObject(VertexData* vertexData, Texture2D* texture, RenderableObjectShaderProgram* program);
 			
 			RenderableObjectShaderProgram* getShaderProgram();
@@ -183,10 +471,29 @@ namespace Knee {
 
 			const VertexData* getVertexData() const;
 
+			// get a sphere containing the object in world space
+			void getBoundingSphere(glm::vec3& center, float& radius);
+
 			Knee::Texture2D* getTexture();
 			void setTexture(Knee::Texture2D* texture);
 			bool hasTexture();
 
+			uint32_t getLayerMask();
+			void setLayerMask(uint32_t layerMask);
+
+			uint32_t getMaxPortalDepth();
+			void setMaxPortalDepth(uint32_t maxPortalDepth);
+
+			// whether the object should be drawn in a pass with the given layer mask, seen through portalDepth portals (0 for the main view)
+			bool isInPass(uint32_t layerMask, uint32_t portalDepth);
+
+			// compare against getLatestRenderStateVersion() at some point in time to find out if the object is drawn differently since then
+			uint64_t getRenderStateVersion() const;
+			static uint64_t getLatestRenderStateVersion();
+
+			// true for objects that can't be drawn with just the usual uniforms, which DrawList leaves to draw themselves
+			virtual bool hasCustomDraw();
+
 			virtual void draw();
 	};
 }
\ No newline at end of file
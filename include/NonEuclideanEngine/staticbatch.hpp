@@ -0,0 +1,77 @@
+#pragma once
+
+#include <NonEuclideanEngine/shader.hpp>
+
+#include <vector>
+#include <unordered_map>
+
+namespace Knee {
+	class Cell;
+
+	// static objects merged into one mesh that's already in world space, drawn in their place
+	class StaticBatch final : public RenderableObject {
+		// the merged mesh, which the batch owns
+		Knee::VertexData* m_mergedVertexData;
+
+		// the objects that were merged
+		std::vector<Knee::RenderableObject*> m_sources;
+
+		public:
+			StaticBatch(Knee::VertexData* mergedVertexData, Knee::Texture2D* texture, Knee::RenderableObjectShaderProgram* program, const std::vector<Knee::RenderableObject*>& sources);
+			~StaticBatch();
+
+			StaticBatch(const StaticBatch&) = delete;
+			StaticBatch& operator=(StaticBatch const&) = delete;
+
+			std::vector<Knee::RenderableObject*>* getSources();
+	};
+
+	// merges static objects that would be drawn with the same state into batches, so a static world takes a handful of draws instead of one per object
+	// objects are only merged with others in the same cell with the same program, texture, layers, portal depth, and vertex layout, so culling + pass filtering still work on whole batches
+	// baking is slow (every mesh is read back from the gpu), so it's done once a level is loaded and again only when a batched object changes
+	class StaticBatcher {
+		// batches are split once they reach this many vertices, so that they can still be culled (and drawn with 16 bit indices)
+		const static uint32_t MAX_BATCH_VERTICES = 65536;
+
+		std::vector<Knee::StaticBatch*> m_batches;
+
+		// the batch each merged object is in
+		std::unordered_map<Knee::RenderableObject*, Knee::StaticBatch*> m_objectBatches;
+
+		// newest transform version when the batches were baked, anything merged that's newer has moved since
+		uint64_t m_bakeVersion = 0;
+
+		// same for render state, anything merged that's newer would now be grouped differently
+		uint64_t m_bakeRenderStateVersion = 0;
+		bool m_baked = false;
+
+		// an object can be merged if it's drawn the usual way with a full model matrix
+		static bool canBatch(Knee::RenderableObject* obj);
+
+		// merge one group of objects, all sharing the same state
+		Knee::StaticBatch* createBatch(const std::vector<Knee::RenderableObject*>& objects);
+
+		public:
+			StaticBatcher();
+			~StaticBatcher();
+
+			StaticBatcher(const StaticBatcher&) = delete;
+			StaticBatcher& operator=(StaticBatcher const&) = delete;
+
+			// throw away any old batches and merge the objects that can be, keeping objects in different cells apart
+			void bake(const std::vector<Knee::RenderableObject*>& objects, const std::vector<Knee::Cell*>& cells);
+
+			// throw away every batch, so objects are drawn on their own until the next bake
+			void clear();
+
+			bool isBaked();
+
+			// true if any merged object has moved or had its program, texture, layers, or max portal depth changed since the bake
+			bool isStale();
+
+			// fill drawn with objects, except that merged objects are replaced by their batch (once, where its first object was)
+			void substitute(const std::vector<Knee::RenderableObject*>& objects, std::vector<Knee::RenderableObject*>& drawn);
+
+			uint32_t getBatchCount();
+	};
+}
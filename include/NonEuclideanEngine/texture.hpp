@@ -3,6 +3,9 @@
 #include <SDL2/SDL_image.h>
 #include <glad/glad.h>
 #include <string>
+#include <vector>
+#include <map>
+#include <set>
 
 namespace Knee {
 	// class for creating GL textures from files using SDL_Surface
@@ -16,6 +19,9 @@ namespace Knee {
 		uint32_t m_width;
 		uint32_t m_height;
 
+		// format the texture is stored as on the gpu
+		GLenum m_internalFormat;
+
 		protected:
 			GLint SDLPixelFormatToInternalGLFormat(const SDL_PixelFormat*);
 			GLint SDLPixelFormatToGLFormat(const SDL_PixelFormat*);
@@ -27,12 +33,13 @@ namespace Knee {
 			Texture2D(std::string);
 
 			// constructor for blank texture - just creates an empty gl texture given the desired values
-			Texture2D(uint32_t width, uint32_t height);
+			Texture2D(uint32_t width, uint32_t height, GLenum internalFormat = GL_RGB);
 
 			~Texture2D();
 
 			uint32_t getWidth();
 			uint32_t getHeight();
+			GLenum getInternalFormat();
 						
 			GLint getGLTexture();
 	};
@@ -43,8 +50,14 @@ namespace Knee {
 		uint32_t m_framebuffer;
 		uint32_t m_renderbuffer;
 
+		// false if the depth + stencil renderbuffer was provided by someone else and shouldn't be deleted with us
+		bool m_ownsRenderbuffer;
+
 		public:
-			Framebuffer2D(uint32_t width, uint32_t height);
+			Framebuffer2D(uint32_t width, uint32_t height, GLenum internalFormat = GL_RGB);
+
+			// create a framebuffer which uses an existing depth + stencil renderbuffer of the same size
+			Framebuffer2D(uint32_t width, uint32_t height, GLenum internalFormat, uint32_t depthStencilRenderbuffer);
 
 			~Framebuffer2D();
 			
@@ -53,5 +66,64 @@ namespace Knee {
 
 			// binds the active framebuffer to itself
 			void bind();
+
+			// copies the bottom left width x height pixels of our color into target, leaving target bound
+			void blitColor(Knee::Framebuffer2D* target, uint32_t width, uint32_t height);
+
+			// false if the driver doesn't support rendering to this combination of attachments
+			bool isComplete();
+	};
+
+	// hands out framebuffers on demand and takes them back once they're no longer needed, so that render targets only exist for as many as are in use at once.
+	// framebuffers of the same size share a single depth + stencil renderbuffer, since depth is cleared by every pass that uses it
+	class FramebufferPool {
+		struct PooledFramebuffer {
+			Knee::Framebuffer2D* framebuffer;
+
+			// currently handed out
+			bool inUse;
+
+			// handed out at some point since the last call to endFrame
+			bool usedThisFrame;
+
+			// stays handed out across frames until released
+			bool retained;
+		};
+
+		struct SharedRenderbuffer {
+			uint32_t renderbuffer;
+			uint32_t users;
+		};
+
+		std::vector<PooledFramebuffer> m_framebuffers;
+
+		// depth + stencil renderbuffers, mapped by (width, height)
+		std::map<std::pair<uint32_t, uint32_t>, SharedRenderbuffer> m_depthStencilRenderbuffers;
+
+		// formats which turned out to not be renderable
+		std::set<GLenum> m_unsupportedFormats;
+
+		protected:
+			void destroyFramebuffer(Knee::Framebuffer2D* framebuffer);
+
+		public:
+			FramebufferPool();
+			~FramebufferPool();
+
+			// get an unused framebuffer of the given size and format, creating one if none are free
+			// if the format can't be rendered to, a GL_RGB8 framebuffer is given instead
+			Knee::Framebuffer2D* acquire(uint32_t width, uint32_t height, GLenum internalFormat = GL_RGB);
+
+			// give a framebuffer back so that it can be handed out again
+			void release(Knee::Framebuffer2D* framebuffer);
+
+			// keep a framebuffer that's been handed out from being taken back by endFrame, until it's released
+			void retain(Knee::Framebuffer2D* framebuffer);
+
+			// releases every framebuffer that isn't retained and frees any that weren't used since the last call, so memory follows what the last frame actually needed
+			void endFrame();
+
+			uint32_t getFramebufferCount();
+			uint32_t getInUseCount();
 	};
 }
\ No newline at end of file
@@ -3,17 +3,50 @@
 layout (location=0) in vec3 in_vertexPosition;
 layout (location=1) in vec2 in_textureCoordinates;
 
-// projection * view * model matrix
-uniform mat4 u_mvp;
+// the camera being drawn from, shared by every shader and only updated when the camera changes
+layout (std140) uniform Camera {
+	mat4 u_view;
+	mat4 u_projection;
+	mat4 u_viewProjection;
+	vec4 u_cameraPosition;
+
+	// near, far
+	vec4 u_cameraDepthRange;
+};
+
+// model matrix, only used when u_instanceBase is negative
+uniform mat4 u_model;
+
+// model matrix columns for every object in the draw list, 4 texels each
+uniform samplerBuffer u_objectTransforms;
+
+// which object in u_objectTransforms each instance drawn this frame is
+uniform usamplerBuffer u_instanceObjects;
+
+// where this draw's instances start in u_instanceObjects, or -1 to draw one instance with u_model
+uniform int u_instanceBase;
 
 // output texture coordinates
 out vec2 TextureCoordinates;
 
 void main(){
-	gl_Position = u_mvp * vec4(in_vertexPosition, 1);
+	mat4 model = u_model;
+
+	if(u_instanceBase >= 0){
+		int base = int(texelFetch(u_instanceObjects, u_instanceBase + gl_InstanceID).r) * 4;
+
+		model = mat4(
+			texelFetch(u_objectTransforms, base),
+			texelFetch(u_objectTransforms, base + 1),
+			texelFetch(u_objectTransforms, base + 2),
+			texelFetch(u_objectTransforms, base + 3)
+		);
+	}
+
+	gl_Position = u_viewProjection * model * vec4(in_vertexPosition, 1);
 	
 	TextureCoordinates = in_textureCoordinates;
 
 	// FIXME: we should flip tex coords properly
 	TextureCoordinates.y = 1.0 - TextureCoordinates.y;
-}
\ No newline at end of file
+}
@@ -1,7 +1,7 @@
 #version 330 core
 
 // in vars
-noperspective in vec2 TextureCoordinates;
+noperspective in vec3 TextureCoordinates;
 
 // out vars
 out vec4 FragColor;
@@ -13,9 +13,19 @@ uniform sampler2D u_sampler;
 // used to make infinite portal more convincing
 uniform float u_brightness;
 
+// flat color used instead of the texture when u_useFillColor is set
+// used to clear the portal's region when rendering with the stencil buffer
+uniform bool u_useFillColor;
+uniform vec4 u_fillColor;
+
 void main(){
-	vec4 textureColor = texture(u_sampler, TextureCoordinates);
+	if(u_useFillColor){
+		FragColor = u_fillColor;
+		return;
+	}
+
+	vec4 textureColor = texture(u_sampler, TextureCoordinates.xy / TextureCoordinates.z);
 
 	FragColor = textureColor * u_brightness;
-	//FragColor = vec4(TextureCoordinates, 0, 1);
+	//FragColor = vec4(TextureCoordinates.xy / TextureCoordinates.z, 0, 1);
 }
\ No newline at end of file
@@ -3,18 +3,34 @@
 layout (location=0) in vec3 in_vertexPosition;
 layout (location=1) in vec2 in_textureCoordinates;
 
-// projection * view * model matrix
-uniform mat4 u_mvp;
+// the camera being drawn from, shared by every shader and only updated when the camera changes
+layout (std140) uniform Camera {
+	mat4 u_view;
+	mat4 u_projection;
+	mat4 u_viewProjection;
+	vec4 u_cameraPosition;
 
-// output texture coordinates
-noperspective out vec2 TextureCoordinates;
+	// near, far
+	vec4 u_cameraDepthRange;
+};
+
+// model matrix
+uniform mat4 u_model;
+
+// maps NDC to texture coordinates
+// the portal's texture only covers the portal's bounds on screen, and the view the portal is drawn in may itself only cover part of the screen
+// this can also be projective when a texture is being warped onto a recursion level it wasn't rendered for
+uniform mat3 u_textureTransform;
+
+// output texture coordinates, in homogeneous coordinates
+noperspective out vec3 TextureCoordinates;
 
 void main(){
-	gl_Position = u_mvp * vec4(in_vertexPosition, 1);
+	gl_Position = u_viewProjection * u_model * vec4(in_vertexPosition, 1);
 
 	// we don't want to project the texture onto the surface, but rather sample the texture according to the absolute position of the fragment on the screen so that the texture matches up exactly.
 	// we do this by determining where the fragment is on screen using gl_Position and the w component, then relying on the interpolation done by glsl
-	// NDC space is in -1.0 to 1.0 while texture coordinates are 0.0 to 1.0, so we normalize that here as well
+	// the mapping from NDC to the portal texture is linear in homogeneous coordinates, so it's fine to apply it here and interpolate the result as long as the division happens per fragment
 	// it's also important that we add the noperspective qualifier to ensure that it interpolates in window space, so each fragment has the correct texture coordinate mapping 1-1 with the NDC
-	TextureCoordinates = (gl_Position.xy / gl_Position.w)*0.5 + 0.5;
+	TextureCoordinates = u_textureTransform * vec3(gl_Position.xy / gl_Position.w, 1);
 }
\ No newline at end of file
@@ -3,6 +3,7 @@
 // includes //
 #include <NonEuclideanEngine/application.hpp>
 #include <NonEuclideanEngine/misc.hpp>
+#include <NonEuclideanEngine/glstate.hpp>
 
 #include <SDL2/SDL_image.h>
 
@@ -74,8 +75,11 @@ void Knee::Application::initialize(){
 		std::cout << Knee::ERROR_PREFACE << "Failed to initialize GLAD" << std::endl;
 	}
 	
+	// nothing has been bound in the new context yet
+	Knee::GLState::reset();
+
 	// set viewport size
-	glViewport(0, 0, this->m_windowWidth, this->m_windowHeight);
+	Knee::GLState::setViewport(0, 0, this->m_windowWidth, this->m_windowHeight);
 	
 	this->setSwapInterval(0);
 	
@@ -0,0 +1,198 @@
+#include <NonEuclideanEngine/cell.hpp>
+#include <NonEuclideanEngine/portal.hpp>
+
+#include <set>
+#include <utility>
+
+// -------------------- //
+// Cell //
+
+Knee::Cell::Cell(){}
+
+void Knee::Cell::addRenderableObject(Knee::RenderableObject* obj){
+	if(obj == NULL) return;
+
+	this->m_renderableObjects.push_back(obj);
+}
+
+void Knee::Cell::addVisualPortal(Knee::VisualPortal* portal){
+	if(portal == NULL) return;
+
+	this->m_visualPortals.push_back(portal);
+	this->addRenderableObject(portal->asRenderableObject());
+
+	portal->setCell(this);
+}
+
+std::vector<Knee::RenderableObject*>* Knee::Cell::getRenderableObjects(){
+	return &this->m_renderableObjects;
+}
+
+std::vector<Knee::VisualPortal*>* Knee::Cell::getVisualPortals(){
+	return &this->m_visualPortals;
+}
+
+std::vector<Knee::Cell*>* Knee::Cell::getVisibleCells(){
+	return &this->m_visibleCells;
+}
+
+std::vector<Knee::RenderableObject*>* Knee::Cell::getVisibleObjects(){
+	return &this->m_visibleObjects;
+}
+
+std::vector<Knee::RenderableObject*>* Knee::Cell::getDrawnObjects(){
+	return &this->m_drawnObjects;
+}
+
+std::vector<Knee::VisualPortal*>* Knee::Cell::getVisiblePortals(){
+	return &this->m_visiblePortals;
+}
+
+bool Knee::Cell::canSee(Knee::Cell* cell){
+	for(uint32_t i = 0; i < this->m_visibleCells.size(); i++){
+		if(this->m_visibleCells.at(i) == cell) return true;
+	}
+
+	return false;
+}
+
+// -------------------- //
+// CellGraph //
+
+Knee::CellGraph::CellGraph(){}
+
+void Knee::CellGraph::addCell(Knee::Cell* cell){
+	if(cell == NULL) return;
+
+	this->m_cells.push_back(cell);
+
+	// the new cell has no visibility yet
+	this->m_computed = false;
+}
+
+void Knee::CellGraph::computeVisibility(std::vector<Knee::RenderableObject*>* renderableObjects, std::vector<Knee::VisualPortal*>* visualPortals){
+	// find everything that's in a cell
+	std::set<Knee::RenderableObject*> cellObjects;
+
+	for(uint32_t i = 0; i < this->m_cells.size(); i++){
+		Knee::Cell* cell = this->m_cells.at(i);
+
+		cell->m_index = i;
+		cellObjects.insert(cell->m_renderableObjects.begin(), cell->m_renderableObjects.end());
+	}
+
+	// anything that isn't is in every cell
+	std::vector<Knee::RenderableObject*> sharedObjects;
+	std::vector<Knee::VisualPortal*> sharedPortals;
+
+	for(uint32_t i = 0; i < renderableObjects->size(); i++){
+		Knee::RenderableObject* obj = renderableObjects->at(i);
+
+		if(cellObjects.count(obj) == 0) sharedObjects.push_back(obj);
+	}
+
+	for(uint32_t i = 0; i < visualPortals->size(); i++){
+		Knee::VisualPortal* portal = visualPortals->at(i);
+
+		if(portal->getCell() == NULL) sharedPortals.push_back(portal);
+	}
+
+	for(uint32_t i = 0; i < this->m_cells.size(); i++){
+		Knee::Cell* cell = this->m_cells.at(i);
+
+		std::vector<bool> visible(this->m_cells.size(), false);
+
+		this->addVisibleCells(cell, *visualPortals, sharedPortals, visible);
+
+		cell->m_visibleCells.clear();
+		cell->m_visiblePortals = sharedPortals;
+
+		for(uint32_t j = 0; j < this->m_cells.size(); j++){
+			if(!visible.at(j)) continue;
+
+			Knee::Cell* visibleCell = this->m_cells.at(j);
+
+			cell->m_visibleCells.push_back(visibleCell);
+			cell->m_visiblePortals.insert(cell->m_visiblePortals.end(), visibleCell->m_visualPortals.begin(), visibleCell->m_visualPortals.end());
+		}
+
+		cell->m_visibleObjects = cell->m_renderableObjects;
+		cell->m_visibleObjects.insert(cell->m_visibleObjects.end(), sharedObjects.begin(), sharedObjects.end());
+
+		cell->m_drawnObjects = cell->m_visibleObjects;
+	}
+
+	this->m_computed = true;
+}
+
+void Knee::CellGraph::addVisibleCells(Knee::Cell* cell, const std::vector<Knee::VisualPortal*>& allPortals, const std::vector<Knee::VisualPortal*>& sharedPortals, std::vector<bool>& visible){
+	visible.at(cell->m_index) = true;
+
+	// portals still to be looked through + the ones that already have been
+	std::vector<Knee::CellGraph::VisibilityState> open;
+	std::set<std::pair<Knee::VisualPortal*, float>> closed;
+
+	// the camera could be anywhere in the cell, so its portals can be looked through from either side
+	std::vector<Knee::VisualPortal*> portals = cell->m_visualPortals;
+	portals.insert(portals.end(), sharedPortals.begin(), sharedPortals.end());
+
+	for(uint32_t i = 0; i < portals.size(); i++){
+		Knee::VisualPortal* portal = portals.at(i);
+
+		if(!portal->hasPair() || portal->isOwnPair()) continue;
+
+		open.push_back({ portal, 1.0f });
+		open.push_back({ portal, -1.0f });
+	}
+
+	while(!open.empty()){
+		Knee::CellGraph::VisibilityState state = open.back();
+		open.pop_back();
+
+		if(!closed.insert(std::make_pair(state.portal, state.side)).second) continue;
+
+		Knee::VisualPortal* pair = state.portal->getPair();
+		Knee::Cell* pairCell = pair->getCell();
+
+		// a pair that isn't in a cell could be looking at anything
+		const std::vector<Knee::VisualPortal*>* candidates = &allPortals;
+
+		if(pairCell != NULL){
+			visible.at(pairCell->m_index) = true;
+
+			portals = pairCell->m_visualPortals;
+			portals.insert(portals.end(), sharedPortals.begin(), sharedPortals.end());
+
+			candidates = &portals;
+		}
+
+		// the camera ends up on the same side of the pair as it was of the portal, so only the other side of the pair can be seen
+		glm::vec3 normal = glm::normalize(pair->getLocalZAxis());
+		glm::vec3 position = pair->getPosition();
+
+		for(uint32_t i = 0; i < candidates->size(); i++){
+			Knee::VisualPortal* portal = candidates->at(i);
+
+			if(!portal->hasPair() || portal->isOwnPair()) continue;
+
+			glm::vec3 center;
+			float radius;
+
+			portal->getBoundingSphere(center, radius);
+
+			if(state.side * glm::dot(normal, center - position) >= radius) continue;
+
+			// we don't know where in the pair's view the camera is, so it could see either side of the portal
+			open.push_back({ portal, 1.0f });
+			open.push_back({ portal, -1.0f });
+		}
+	}
+}
+
+bool Knee::CellGraph::isComputed(){
+	return this->m_computed;
+}
+
+std::vector<Knee::Cell*>* Knee::CellGraph::getCells(){
+	return &this->m_cells;
+}
@@ -0,0 +1,266 @@
+#include <NonEuclideanEngine/drawlist.hpp>
+#include <NonEuclideanEngine/glstate.hpp>
+
+#include <algorithm>
+
+// -------------------- //
+// DrawList::StreamingTextureBuffer //
+
+void Knee::DrawList::StreamingTextureBuffer::orphan(){
+	this->uploadedSize = 0;
+
+	if(this->buffer == 0) return;
+
+	glBindBuffer(GL_TEXTURE_BUFFER, this->buffer);
+	glBufferData(GL_TEXTURE_BUFFER, this->capacity, NULL, GL_STREAM_DRAW);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void Knee::DrawList::StreamingTextureBuffer::upload(const void* data, size_t size, GLuint unit){
+	if(this->buffer == 0){
+		// binding creates the buffer, which has to exist before the texture can be attached to it
+		glGenBuffers(1, &this->buffer);
+		glBindBuffer(GL_TEXTURE_BUFFER, this->buffer);
+		glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+		glGenTextures(1, &this->texture);
+
+		// attached once, since the texture keeps seeing the buffer's storage however often it's respecified
+		Knee::GLState::bindTexture(unit, GL_TEXTURE_BUFFER, this->texture);
+		glTexBuffer(GL_TEXTURE_BUFFER, this->format, this->buffer);
+	}
+
+	Knee::GLState::bindTexture(unit, GL_TEXTURE_BUFFER, this->texture);
+
+	if(this->uploadedSize == size) return;
+
+	glBindBuffer(GL_TEXTURE_BUFFER, this->buffer);
+
+	// grow to fit everything, which means everything has to be uploaded again
+	if(size > this->capacity){
+		this->capacity = std::max(size, this->capacity * 2);
+
+		glBufferData(GL_TEXTURE_BUFFER, this->capacity, NULL, GL_STREAM_DRAW);
+
+		this->uploadedSize = 0;
+	}
+
+	glBufferSubData(GL_TEXTURE_BUFFER, this->uploadedSize, size - this->uploadedSize, (const char*)data + this->uploadedSize);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+	this->uploadedSize = size;
+}
+
+void Knee::DrawList::StreamingTextureBuffer::destroy(){
+	if(this->texture != 0) Knee::GLState::deleteTexture(this->texture);
+	if(this->buffer != 0) glDeleteBuffers(1, &this->buffer);
+
+	this->texture = 0;
+	this->buffer = 0;
+	this->capacity = 0;
+	this->uploadedSize = 0;
+}
+
+// -------------------- //
+// DrawList //
+
+uint64_t Knee::DrawList::LATEST_FRAME = 0;
+
+Knee::DrawList::DrawList(){
+	this->m_transformBuffer.format = GL_RGBA32F;
+	this->m_instanceBuffer.format = GL_R32UI;
+}
+
+Knee::DrawList::~DrawList(){
+	this->m_transformBuffer.destroy();
+	this->m_instanceBuffer.destroy();
+}
+
+void Knee::DrawList::beginFrame(){
+	this->m_frame = ++Knee::DrawList::LATEST_FRAME;
+	this->m_items.clear();
+	this->m_transforms.clear();
+	this->m_instances.clear();
+	this->m_drawCallCount = 0;
+
+	this->m_transformBuffer.orphan();
+	this->m_instanceBuffer.orphan();
+}
+
+const Knee::DrawItem& Knee::DrawList::getItem(Knee::RenderableObject* obj){
+	if(obj->m_drawFrame == this->m_frame) return this->m_items.at(obj->m_drawIndex);
+
+	obj->m_drawFrame = this->m_frame;
+	obj->m_drawIndex = this->m_items.size();
+
+	this->m_items.push_back(Knee::DrawItem());
+
+	Knee::DrawItem& item = this->m_items.back();
+
+	item.object = obj;
+	item.program = obj->getShaderProgram();
+	item.vertexData = obj->getVertexData();
+	item.texture = obj->getTexture();
+	item.index = obj->m_drawIndex;
+	item.custom = obj->hasCustomDraw();
+
+	// objects that aren't on any layer can't be in a pass anyways
+	uint32_t layerMask = obj->getLayerMask();
+
+	while(layerMask != 0 && (layerMask & (1u << item.layer)) == 0) item.layer++;
+
+	obj->getBoundingSphere(item.center, item.radius);
+
+	glm::vec3 scale = glm::abs(obj->getScale());
+	item.maxScale = std::max(scale.x, std::max(scale.y, scale.z));
+
+	// the model matrix goes to the gpu with the next draw
+	glm::mat4 model = obj->getModelMatrix();
+
+	for(uint32_t i = 0; i < 4; i++){
+		this->m_transforms.push_back(model[i]);
+	}
+
+	return item;
+}
+
+void Knee::DrawList::draw(const std::vector<Knee::RenderableObject*>& objects){
+	// everything has to be compiled + uploaded before anything can be drawn
+	this->m_queue.clear();
+	this->m_passVertexData.resize(objects.size());
+
+	for(uint32_t i = 0; i < objects.size(); i++){
+		const Knee::DrawItem& item = this->getItem(objects.at(i));
+
+		Knee::PerspectiveCamera* camera = item.program->getCamera();
+
+		// use the simplest level of detail that still looks the same from here
+		const Knee::VertexData* lod = item.vertexData;
+
+		if(lod->getLODCount() > 0){
+			lod = lod->getLOD(camera->getPixelsPerUnit(item.center, item.radius) * item.maxScale);
+		}
+
+		this->m_passVertexData.at(i) = lod;
+
+		// w is the distance in front of the camera
+		float depth = (camera->getViewProjectionMatrix() * glm::vec4(item.center, 1)).w / camera->getFar();
+
+		this->m_queue.push(Knee::RenderQueue::makeKey(
+			item.layer,
+			item.custom,
+			item.program->getGLProgram(),
+			// untextured items all share texture 0, so they're grouped into the same runs
+			item.texture != NULL ? item.texture->getGLTexture() : 0,
+			lod->getGLVertexArray(),
+			depth
+		), i);
+	}
+
+	this->m_queue.sort();
+
+	// instances are drawn in sorted order, so each run's items are next to each other
+	uint32_t instance = this->m_instances.size();
+
+	for(uint32_t i = 0; i < this->m_queue.getSize(); i++){
+		const Knee::DrawItem& item = this->getItem(objects.at(this->m_queue.getIndex(i)));
+
+		if(!item.custom) this->m_instances.push_back(item.index);
+	}
+
+	this->m_transformBuffer.upload(this->m_transforms.data(), this->m_transforms.size() * sizeof(glm::vec4), Knee::DrawList::TRANSFORM_TEXTURE_UNIT);
+	this->m_instanceBuffer.upload(this->m_instances.data(), this->m_instances.size() * sizeof(uint32_t), Knee::DrawList::INSTANCE_TEXTURE_UNIT);
+
+	// whatever was last set, NULL (or UNBOUND_TEXTURE) if it needs to be set again
+	const GLuint UNBOUND_TEXTURE = 0xFFFFFFFF;
+
+	Knee::RenderableObjectShaderProgram* program = NULL;
+	const Knee::VertexData* vertexData = NULL;
+	GLuint texture = UNBOUND_TEXTURE;
+
+	const Knee::RenderableObjectUniforms* uniforms = NULL;
+
+	uint32_t i = 0;
+
+	while(i < this->m_queue.getSize()){
+		uint32_t index = this->m_queue.getIndex(i);
+
+		const Knee::DrawItem& item = this->getItem(objects.at(index));
+
+		if(item.custom){
+			item.object->draw();
+			this->m_drawCallCount++;
+
+			// could have changed anything
+			program = NULL;
+			vertexData = NULL;
+			texture = UNBOUND_TEXTURE;
+
+			i++;
+
+			continue;
+		}
+
+		const Knee::VertexData* lod = this->m_passVertexData.at(index);
+
+		// everything after that looks the same to the gpu is drawn along with it
+		uint32_t count = 1;
+
+		while(i + count < this->m_queue.getSize()){
+			uint32_t nextIndex = this->m_queue.getIndex(i + count);
+
+			const Knee::DrawItem& next = this->getItem(objects.at(nextIndex));
+
+			if(next.custom || next.program != item.program || next.texture != item.texture || this->m_passVertexData.at(nextIndex) != lod) break;
+
+			count++;
+		}
+
+		if(item.program != program){
+			program = item.program;
+			program->use();
+
+			// every object texture goes in the first unit
+			uniforms = &program->getUniforms();
+
+			program->resetBoundTextures();
+			program->setUniform(uniforms->sampler, 0);
+			program->setUniform(uniforms->objectTransforms, (GLint)Knee::DrawList::TRANSFORM_TEXTURE_UNIT);
+			program->setUniform(uniforms->instanceObjects, (GLint)Knee::DrawList::INSTANCE_TEXTURE_UNIT);
+
+			// the only thing that changes between passes, which is only copied to the gpu when it has
+			program->getCamera()->useUniformBuffer();
+
+			texture = UNBOUND_TEXTURE;
+		}
+
+		if(lod != vertexData){
+			vertexData = lod;
+			vertexData->use();
+		}
+
+		// untextured runs bind nothing rather than sampling whatever the run before them left bound
+		GLuint runTexture = item.texture != NULL ? item.texture->getGLTexture() : 0;
+
+		if(runTexture != texture){
+			texture = runTexture;
+
+			Knee::GLState::bindTexture(0, GL_TEXTURE_2D, texture);
+		}
+
+		program->setUniform(uniforms->instanceBase, (GLint)instance);
+		program->drawElementsInstanced(vertexData, count);
+		this->m_drawCallCount++;
+
+		instance += count;
+		i += count;
+	}
+}
+
+uint32_t Knee::DrawList::getItemCount(){
+	return this->m_items.size();
+}
+
+uint32_t Knee::DrawList::getDrawCallCount(){
+	return this->m_drawCallCount;
+}
@@ -2,6 +2,7 @@
 #include <NonEuclideanEngine/player.hpp>
 #include <NonEuclideanEngine/game.hpp>
 #include <NonEuclideanEngine/shader.hpp>
+#include <NonEuclideanEngine/glstate.hpp>
 
 #include <iostream>
 
@@ -18,18 +19,18 @@ const std::string Knee::Game::VISUAL_PORTAL_SHADER_ROOT = Knee::Game::SHADER_ROO
 const std::string Knee::Game::VISUAL_PORTAL_VERTEX_SHADER_PATH = Knee::Game::VISUAL_PORTAL_SHADER_ROOT + "/visualportalvertex.glsl";
 const std::string Knee::Game::VISUAL_PORTAL_FRAGMENT_SHADER_PATH = Knee::Game::VISUAL_PORTAL_SHADER_ROOT + "/visualportalfragment.glsl";
 
-const std::string Knee::Game::RENDERABLE_GAMEOBJECT_WITH_DEPTH_SHADER_ROOT = Knee::Game::SHADER_ROOT + "/renderablegameobjectwithdepth";
-const std::string Knee::Game::RENDERABLE_GAMEOBJECT_WITH_DEPTH_VERTEX_SHADER_PATH = Knee::Game::RENDERABLE_GAMEOBJECT_VERTEX_SHADER_PATH;
-const std::string Knee::Game::RENDERABLE_GAMEOBJECT_WITH_DEPTH_FRAGMENT_SHADER_PATH = Knee::Game::RENDERABLE_GAMEOBJECT_WITH_DEPTH_SHADER_ROOT + "/renderablegameobjectwithdepthfragment.glsl";
-
 // TODO: these should definitely be customizable
 Knee::Game::Game(uint32_t windowWidth, uint32_t windowHeight) : 
-	m_renderableGameObjectWithDepthShaderProgram(m_renderableGameObjectShaderProgram.getCamera()),  // link camera,
+	m_windowWidth(windowWidth),
+	m_windowHeight(windowHeight),
 	m_visualPortalShaderProgram(m_renderableGameObjectShaderProgram.getCamera()), // link camera
 	m_renderableGameObjectShaderProgram(glm::radians(45.f), (float)windowWidth / (float)windowHeight, 0.01f, 100.f)
 {
 	// link camera to player
 	this->m_player.setCamera(this->m_renderableGameObjectShaderProgram.getCamera());
+
+	// levels of detail are picked by how big things are in the window
+	this->m_renderableGameObjectShaderProgram.getCamera()->setViewportHeight(windowHeight);
 }
 
 Knee::Game::~Game(){
@@ -46,6 +47,18 @@ Knee::Player* Knee::Game::getPlayer(){
 	return &this->m_player;
 }
 
+Knee::FramebufferPool* Knee::Game::getFramebufferPool(){
+	return &this->m_framebufferPool;
+}
+
+Knee::PortalViewTree* Knee::Game::getPortalViewTree(){
+	return &this->m_portalViewTree;
+}
+
+Knee::DrawList* Knee::Game::getDrawList(){
+	return &this->m_drawList;
+}
+
 // needs to be called AFTER application is initialized or gl context won't be present
 void Knee::Game::initialize(){
 	// attach renderable object shaders
@@ -68,15 +81,6 @@ void Knee::Game::initialize(){
 	}
 
 
-	// attach renderable object with depth shaders
-	if( this->m_renderableGameObjectWithDepthShaderProgram.attachShader(GL_VERTEX_SHADER, Knee::Game::RENDERABLE_GAMEOBJECT_WITH_DEPTH_VERTEX_SHADER_PATH) < 0 ){
-		std::cout << Knee::ERROR_PREFACE << "error attaching renderable gameobject with depth vertex shader" << std::endl;
-	}
-
-	if( this->m_renderableGameObjectWithDepthShaderProgram.attachShader(GL_FRAGMENT_SHADER, Knee::Game::RENDERABLE_GAMEOBJECT_WITH_DEPTH_FRAGMENT_SHADER_PATH) < 0 ){
-		std::cout << Knee::ERROR_PREFACE << "error attaching renderable gameobject with depth fragment shader" << std::endl;
-	}
-
 	// compile renderable gameobject shader program
 	if( this->m_renderableGameObjectShaderProgram.compile() < 0 ){
 		std::cout << Knee::ERROR_PREFACE << "error compiling m_renderableGameObjectShaderProgram" << std::endl;
@@ -87,12 +91,6 @@ void Knee::Game::initialize(){
 	if( this->m_visualPortalShaderProgram.compile() < 0){
 		std::cout << Knee::ERROR_PREFACE << "error compiling m_visualPortalShaderProgram" << std::endl;
 	}
-
-
-	// compile renderable gameobject with depth shader program
-	if( this->m_visualPortalShaderProgram.compile() < 0){
-		std::cout << Knee::ERROR_PREFACE << "error compiling m_renderableGameObjectWithDepthShaderProgram" << std::endl;
-	}
 }
 
 Knee::StaticGameObject* Knee::Game::getStaticGameObject(std::string id){
@@ -143,6 +141,9 @@ void Knee::Game::addRenderableStaticGameObject(std::string id, Knee::RenderableS
 
 	// push to renderable objects
 	this->m_renderableGameObjects.push_back(obj->asRenderableObject());
+	this->m_staticRenderableObjects.push_back(obj->asRenderableObject());
+
+	this->invalidateStaticBatches();
 
 	// cast to StaticGameObject
 	Knee::StaticGameObject* staticGameObj = obj->asStaticGameObject();
@@ -159,6 +160,8 @@ void Knee::Game::addRenderableGameObject(std::string id, Knee::RenderableGameObj
 
 	// push to renderable objects
 	this->m_renderableGameObjects.push_back(obj->asRenderableObject());
+
+	this->invalidateStaticBatches();
 	
 	// cast to GameObject
 	Knee::GameObject* gameObj = obj->asGameObject();
@@ -172,6 +175,9 @@ void Knee::Game::addVisualPortal(std::string id, VisualPortal* portal){
 	// push to visual portals
 	this->m_visualPortals.push_back(portal);
 
+	// match the game's render mode
+	portal->setRenderMode(this->m_portalRenderMode);
+
 	// cast to renderable static game object
 	Knee::RenderableStaticGameObject* staticGameObj = portal->asRenderableStaticGameObject();
 
@@ -182,6 +188,94 @@ void Knee::Game::addVisualPortal(std::string id, VisualPortal* portal){
 	portal->setShaderProgram(&this->m_visualPortalShaderProgram);
 }
 
+void Knee::Game::addCell(std::string id, Cell* cell){
+	if(cell == NULL || id.length() < 1) return;
+
+	// add to cells by id
+	this->m_cells[id] = cell;
+
+	this->m_cellGraph.addCell(cell);
+
+	this->invalidateStaticBatches();
+}
+
+Knee::Cell* Knee::Game::getCell(std::string id){
+	try {
+		Knee::Cell* cell = this->m_cells.at(id);
+
+		return cell;
+	} catch( const std::out_of_range& e ){
+		std::cout << Knee::ERROR_PREFACE << "no Cell found with id " << id << ", returning NULL" << std::endl;
+
+		// this is thrown when there is no element that exists at the id, so return null
+		return NULL;
+	}
+}
+
+void Knee::Game::computeCellVisibility(){
+	this->m_cellGraph.computeVisibility(&this->m_renderableGameObjects, &this->m_visualPortals);
+
+	// batches are split by cell, and the cells' drawn lists have just been reset
+	this->invalidateStaticBatches();
+
+	// anything rendered through portals before this was seeing every cell
+	this->m_portalViewTree.getTextureCache()->clear(&this->m_framebufferPool);
+}
+
+void Knee::Game::bakeStaticBatches(){
+	std::vector<Knee::Cell*>* cells = this->m_cellGraph.getCells();
+
+	this->m_staticBatcher.bake(this->m_staticRenderableObjects, *cells);
+	this->updateDrawnObjects();
+}
+
+void Knee::Game::invalidateStaticBatches(){
+	this->m_staticBatcher.clear();
+	this->updateDrawnObjects();
+}
+
+Knee::StaticBatcher* Knee::Game::getStaticBatcher(){
+	return &this->m_staticBatcher;
+}
+
+void Knee::Game::updateDrawnObjects(){
+	this->m_staticBatcher.substitute(this->m_renderableGameObjects, this->m_drawnRenderableObjects);
+
+	std::vector<Knee::Cell*>* cells = this->m_cellGraph.getCells();
+
+	for(uint32_t i = 0; i < cells->size(); i++){
+		Knee::Cell* cell = cells->at(i);
+
+		this->m_staticBatcher.substitute(*cell->getVisibleObjects(), *cell->getDrawnObjects());
+	}
+}
+
+std::vector<Knee::RenderableObject*>* Knee::Game::getDrawnRenderableObjects(){
+	if(this->m_playerCell == NULL || !this->m_cellGraph.isComputed()) return &this->m_drawnRenderableObjects;
+
+	return this->m_playerCell->getDrawnObjects();
+}
+
+Knee::Cell* Knee::Game::getPlayerCell(){
+	return this->m_playerCell;
+}
+
+void Knee::Game::setPlayerCell(Knee::Cell* cell){
+	this->m_playerCell = cell;
+}
+
+std::vector<Knee::RenderableObject*>* Knee::Game::getVisibleRenderableObjects(){
+	if(this->m_playerCell == NULL || !this->m_cellGraph.isComputed()) return &this->m_renderableGameObjects;
+
+	return this->m_playerCell->getVisibleObjects();
+}
+
+std::vector<Knee::VisualPortal*>* Knee::Game::getVisibleVisualPortals(){
+	if(this->m_playerCell == NULL || !this->m_cellGraph.isComputed()) return &this->m_visualPortals;
+
+	return this->m_playerCell->getVisiblePortals();
+}
+
 void Knee::Game::addPortal(std::string id, Portal* portal){
 	if(portal == NULL || id.length() < 1) return;
 
@@ -211,24 +305,99 @@ void Knee::Game::updatePlayer(double delta){
 }
 
 void Knee::Game::renderAllRenderableGameObjects(){
+	// only what's in the player's cell can be seen directly
+	std::vector<RenderableObject*>* renderableObjects = this->getDrawnRenderableObjects();
+
+	this->m_mainPassObjects.clear();
+
 	// iterate through each renderable game object and update
-	for(uint32_t i = 0; i < this->m_renderableGameObjects.size(); i++){
+	for(uint32_t i = 0; i < renderableObjects->size(); i++){
 		// fetch object
-		RenderableObject* obj = this->m_renderableGameObjects.at(i);
-		
-		// render
-		obj->draw();
+		RenderableObject* obj = renderableObjects->at(i);
+
+		// skip anything that's been left out of the main view
+		if(!obj->isInPass(this->m_layerMask, 0)) continue;
+
+		this->m_mainPassObjects.push_back(obj);
 	}
+
+	// render
+	this->m_drawList.draw(this->m_mainPassObjects);
 }
 
 void Knee::Game::updateVisualPortals(){
-	// iterate through all visual portals
-	for(uint32_t i = 0; i < this->m_visualPortals.size(); i++){
+	// portals in cells that can't be seen from the player's are never considered
+	Knee::Cell* cell = this->m_cellGraph.isComputed() ? this->m_playerCell : NULL;
+	std::vector<VisualPortal*>* visualPortals = this->getVisibleVisualPortals();
+
+	// find what can be seen through portals from the camera, then render it
+	this->m_portalViewTree.build(this->m_renderableGameObjectShaderProgram.getCamera(), cell, this->m_layerMask, visualPortals, this->m_windowWidth, this->m_windowHeight);
+	this->m_portalViewTree.loadPortalTextures(visualPortals, &this->m_drawnRenderableObjects, &this->m_drawList, &this->m_framebufferPool, this->m_windowWidth, this->m_windowHeight);
+}
+
+void Knee::Game::renderVisualPortalsStencil(){
+	Knee::Cell* cell = this->m_cellGraph.isComputed() ? this->m_playerCell : NULL;
+	std::vector<VisualPortal*>* visualPortals = this->getVisibleVisualPortals();
+
+	// find what can be seen through portals from the camera, then render it starting from the main view's stencil level
+	this->m_portalViewTree.build(this->m_renderableGameObjectShaderProgram.getCamera(), cell, this->m_layerMask, visualPortals, this->m_windowWidth, this->m_windowHeight);
+	this->m_portalViewTree.renderPortalsStencil(visualPortals, &this->m_drawnRenderableObjects, &this->m_drawList, this->m_windowWidth, this->m_windowHeight);
+}
+
+void Knee::Game::queryVisualPortalOcclusion(){
+	// results from earlier frames (or for portals in cells we can't see from here) are stale
+	this->clearVisualPortalOcclusion();
+
+	std::vector<VisualPortal*>* visualPortals = this->getVisibleVisualPortals();
+
+	// a portal off screen would come back hidden, even though it could turn into view next frame
+	Knee::Frustum frustum(this->m_renderableGameObjectShaderProgram.getCamera()->getViewProjectionMatrix());
+
+	for(uint32_t i = 0; i < visualPortals->size(); i++){
 		// get portal
-		VisualPortal* portal = this->m_visualPortals.at(i);
+		VisualPortal* portal = visualPortals->at(i);
+
+		// nothing is ever rendered through these anyways
+		if(!portal->hasPair() || portal->isOwnPair()) continue;
+
+		glm::vec3 center;
+		float radius;
+
+		portal->getBoundingSphere(center, radius);
+
+		if(!frustum.intersectsSphere(center, radius)) continue;
+
+		portal->queryOcclusion();
+	}
+}
+
+void Knee::Game::clearVisualPortalOcclusion(){
+	for(uint32_t i = 0; i < this->m_visualPortals.size(); i++){
+		this->m_visualPortals.at(i)->clearOcclusion();
+	}
+}
+
+uint32_t Knee::Game::getLayerMask(){
+	return this->m_layerMask;
+}
+
+void Knee::Game::setLayerMask(uint32_t layerMask){
+	this->m_layerMask = layerMask;
+}
+
+Knee::PortalRenderMode Knee::Game::getPortalRenderMode(){
+	return this->m_portalRenderMode;
+}
+
+void Knee::Game::setPortalRenderMode(Knee::PortalRenderMode renderMode){
+	this->m_portalRenderMode = renderMode;
 
-		// load texture
-		portal->loadPortalTexture(&this->m_renderableGameObjects, &this->m_renderableGameObjectWithDepthShaderProgram);
+	// cached portal textures are only used in framebuffer mode
+	this->m_portalViewTree.getTextureCache()->clear(&this->m_framebufferPool);
+
+	// update existing portals
+	for(uint32_t i = 0; i < this->m_visualPortals.size(); i++){
+		this->m_visualPortals.at(i)->setRenderMode(renderMode);
 	}
 }
 
@@ -239,6 +408,14 @@ bool Knee::Game::updatePortals(double delta){
 
 		// check player movement
 		if(portal->checkPlayer(this->getPlayer(), delta)){
+			// the player is now wherever the pair is
+			Knee::Cell* cell = portal->getPair()->getCell();
+
+			if(this->m_playerCell != NULL && cell != NULL) this->m_playerCell = cell;
+
+			// the queries were against the view from the other side
+			this->clearVisualPortalOcclusion();
+
 			// end early so we don't have the player moving through the same portal twice
 			return true;
 		}
@@ -248,7 +425,49 @@ bool Knee::Game::updatePortals(double delta){
 }
 
 void Knee::Game::renderScene(){
-	glEnable(GL_DEPTH_TEST);
+	Knee::GLState::enable(GL_DEPTH_TEST);
+
+	// anything added or moved since the last bake has to be merged again
+	if(!this->m_staticBatcher.isBaked() || this->m_staticBatcher.isStale()) this->bakeStaticBatches();
+
+	// objects may have moved since last frame
+	this->m_drawList.beginFrame();
+
+	if(this->m_portalRenderMode == PORTAL_RENDER_MODE_STENCIL){
+		// make sure the whole stencil buffer gets cleared
+		Knee::GLState::setStencilMask(0xFF);
+
+		// clear color + depth + stencil
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+
+		// update camera with latest player position
+		this->updateCamera();
+
+		// main view is stencil level 0
+		Knee::GLState::enable(GL_STENCIL_TEST);
+		Knee::GLState::setStencilFunc(GL_EQUAL, 0, 0xFF);
+		Knee::GLState::setStencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
+
+		// draw renderable objects (portals draw nothing here)
+		this->renderAllRenderableGameObjects();
+
+		// test portals against the main view before anything is drawn through them
+		this->queryVisualPortalOcclusion();
+
+		// draw what can be seen through the portals on top
+		// each portal scissors itself to its own bounds
+		Knee::GLState::enable(GL_SCISSOR_TEST);
+
+		this->renderVisualPortalsStencil();
+
+		Knee::GLState::disable(GL_SCISSOR_TEST);
+		Knee::GLState::disable(GL_STENCIL_TEST);
+
+		// frees anything left over from framebuffer rendering
+		this->m_framebufferPool.endFrame();
+
+		return;
+	}
 
 	// clear color + depth
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -261,6 +480,12 @@ void Knee::Game::renderScene(){
 
 	// draw renderable objects
 	this->renderAllRenderableGameObjects();
+
+	// results are used to skip hidden portals next frame
+	this->queryVisualPortalOcclusion();
+
+	// portal textures have been drawn, so their render targets can be reused next frame
+	this->m_framebufferPool.endFrame();
 }
 
 void Knee::Game::update(double delta){
@@ -0,0 +1,323 @@
+#include <NonEuclideanEngine/glstate.hpp>
+
+#include <cmath>
+
+// -------------------- //
+// GLState //
+
+GLuint Knee::GLState::PROGRAM = Knee::GLState::UNKNOWN;
+GLuint Knee::GLState::VERTEX_ARRAY = Knee::GLState::UNKNOWN;
+
+GLuint Knee::GLState::ACTIVE_TEXTURE_UNIT = Knee::GLState::UNKNOWN;
+GLuint Knee::GLState::TEXTURES[Knee::GLState::MAX_TRACKED_TEXTURE_UNITS][Knee::GLState::TEXTURE_TARGET_COUNT];
+
+GLuint Knee::GLState::DRAW_FRAMEBUFFER = Knee::GLState::UNKNOWN;
+GLuint Knee::GLState::READ_FRAMEBUFFER = Knee::GLState::UNKNOWN;
+
+GLint Knee::GLState::VIEWPORT[4] = { 0, 0, (GLint)Knee::GLState::UNKNOWN, 0 };
+
+std::map<GLenum, bool> Knee::GLState::CAPABILITIES;
+
+GLuint Knee::GLState::DEPTH_FUNC = Knee::GLState::UNKNOWN;
+GLuint Knee::GLState::DEPTH_MASK = Knee::GLState::UNKNOWN;
+GLuint Knee::GLState::COLOR_MASK = Knee::GLState::UNKNOWN;
+
+GLfloat Knee::GLState::DEPTH_RANGE[2] = { NAN, NAN };
+
+GLuint Knee::GLState::STENCIL_FUNC[3] = { Knee::GLState::UNKNOWN, Knee::GLState::UNKNOWN, Knee::GLState::UNKNOWN };
+GLuint Knee::GLState::STENCIL_OP[3] = { Knee::GLState::UNKNOWN, Knee::GLState::UNKNOWN, Knee::GLState::UNKNOWN };
+GLuint Knee::GLState::STENCIL_MASK = Knee::GLState::UNKNOWN;
+
+GLint Knee::GLState::SCISSOR[4] = { 0, 0, (GLint)Knee::GLState::UNKNOWN, 0 };
+
+uint64_t Knee::GLState::ISSUED_COUNTS[STATE_COUNTER_COUNT] = { 0 };
+uint64_t Knee::GLState::SKIPPED_COUNTS[STATE_COUNTER_COUNT] = { 0 };
+
+void Knee::GLState::reset(){
+	Knee::GLState::PROGRAM = Knee::GLState::UNKNOWN;
+	Knee::GLState::VERTEX_ARRAY = Knee::GLState::UNKNOWN;
+
+	Knee::GLState::ACTIVE_TEXTURE_UNIT = Knee::GLState::UNKNOWN;
+
+	for(uint32_t i = 0; i < Knee::GLState::MAX_TRACKED_TEXTURE_UNITS; i++){
+		for(uint32_t j = 0; j < Knee::GLState::TEXTURE_TARGET_COUNT; j++){
+			Knee::GLState::TEXTURES[i][j] = Knee::GLState::UNKNOWN;
+		}
+	}
+
+	Knee::GLState::DRAW_FRAMEBUFFER = Knee::GLState::UNKNOWN;
+	Knee::GLState::READ_FRAMEBUFFER = Knee::GLState::UNKNOWN;
+
+	Knee::GLState::VIEWPORT[2] = (GLint)Knee::GLState::UNKNOWN;
+
+	Knee::GLState::CAPABILITIES.clear();
+
+	Knee::GLState::DEPTH_FUNC = Knee::GLState::UNKNOWN;
+	Knee::GLState::DEPTH_MASK = Knee::GLState::UNKNOWN;
+	Knee::GLState::COLOR_MASK = Knee::GLState::UNKNOWN;
+
+	Knee::GLState::DEPTH_RANGE[0] = NAN;
+	Knee::GLState::DEPTH_RANGE[1] = NAN;
+
+	for(uint32_t i = 0; i < 3; i++){
+		Knee::GLState::STENCIL_FUNC[i] = Knee::GLState::UNKNOWN;
+		Knee::GLState::STENCIL_OP[i] = Knee::GLState::UNKNOWN;
+	}
+
+	Knee::GLState::STENCIL_MASK = Knee::GLState::UNKNOWN;
+
+	Knee::GLState::SCISSOR[2] = (GLint)Knee::GLState::UNKNOWN;
+}
+
+bool Knee::GLState::change(Knee::GLStateCounter counter, GLuint& current, GLuint value){
+	if(current == value){
+		Knee::GLState::SKIPPED_COUNTS[counter]++;
+		return false;
+	}
+
+	current = value;
+	Knee::GLState::ISSUED_COUNTS[counter]++;
+
+	return true;
+}
+
+bool Knee::GLState::change(Knee::GLStateCounter counter, GLuint* current, const GLuint* values, uint32_t count){
+	bool changed = false;
+
+	for(uint32_t i = 0; i < count; i++){
+		changed |= current[i] != values[i];
+		current[i] = values[i];
+	}
+
+	if(!changed){
+		Knee::GLState::SKIPPED_COUNTS[counter]++;
+		return false;
+	}
+
+	Knee::GLState::ISSUED_COUNTS[counter]++;
+
+	return true;
+}
+
+void Knee::GLState::useProgram(GLuint program){
+	if(!Knee::GLState::change(STATE_COUNTER_PROGRAM, Knee::GLState::PROGRAM, program)) return;
+
+	glUseProgram(program);
+}
+
+void Knee::GLState::bindVertexArray(GLuint vertexArray){
+	if(!Knee::GLState::change(STATE_COUNTER_VERTEX_ARRAY, Knee::GLState::VERTEX_ARRAY, vertexArray)) return;
+
+	glBindVertexArray(vertexArray);
+}
+
+int32_t Knee::GLState::getTextureTarget(GLenum target){
+	switch(target){
+		case GL_TEXTURE_2D:
+			return TEXTURE_TARGET_2D;
+		case GL_TEXTURE_BUFFER:
+			return TEXTURE_TARGET_BUFFER;
+		default:
+			return -1;
+	}
+}
+
+void Knee::GLState::setActiveTextureUnit(GLuint unit){
+	// part of binding a texture, so it isn't counted on its own
+	if(Knee::GLState::ACTIVE_TEXTURE_UNIT == unit) return;
+
+	Knee::GLState::ACTIVE_TEXTURE_UNIT = unit;
+
+	glActiveTexture(GL_TEXTURE0 + unit);
+}
+
+void Knee::GLState::bindTexture(GLuint unit, GLenum target, GLuint texture){
+	int32_t trackedTarget = Knee::GLState::getTextureTarget(target);
+
+	// the unit is made active even if the bind is skipped, since callers binding a texture to edit it (glTexImage2D, glTexBuffer...) act on the active unit
+	Knee::GLState::setActiveTextureUnit(unit);
+
+	if(unit < Knee::GLState::MAX_TRACKED_TEXTURE_UNITS && trackedTarget >= 0){
+		if(!Knee::GLState::change(STATE_COUNTER_TEXTURE, Knee::GLState::TEXTURES[unit][trackedTarget], texture)) return;
+	}else{
+		Knee::GLState::ISSUED_COUNTS[STATE_COUNTER_TEXTURE]++;
+	}
+
+	glBindTexture(target, texture);
+}
+
+void Knee::GLState::bindFramebuffer(GLenum target, GLuint framebuffer){
+	bool changed = false;
+
+	if(target == GL_FRAMEBUFFER || target == GL_DRAW_FRAMEBUFFER){
+		changed |= Knee::GLState::DRAW_FRAMEBUFFER != framebuffer;
+		Knee::GLState::DRAW_FRAMEBUFFER = framebuffer;
+	}
+
+	if(target == GL_FRAMEBUFFER || target == GL_READ_FRAMEBUFFER){
+		changed |= Knee::GLState::READ_FRAMEBUFFER != framebuffer;
+		Knee::GLState::READ_FRAMEBUFFER = framebuffer;
+	}
+
+	if(!changed){
+		Knee::GLState::SKIPPED_COUNTS[STATE_COUNTER_FRAMEBUFFER]++;
+		return;
+	}
+
+	Knee::GLState::ISSUED_COUNTS[STATE_COUNTER_FRAMEBUFFER]++;
+
+	glBindFramebuffer(target, framebuffer);
+}
+
+void Knee::GLState::setViewport(GLint x, GLint y, GLsizei width, GLsizei height){
+	GLint* viewport = Knee::GLState::VIEWPORT;
+
+	if(viewport[0] == x && viewport[1] == y && viewport[2] == width && viewport[3] == height){
+		Knee::GLState::SKIPPED_COUNTS[STATE_COUNTER_VIEWPORT]++;
+		return;
+	}
+
+	viewport[0] = x;
+	viewport[1] = y;
+	viewport[2] = width;
+	viewport[3] = height;
+
+	Knee::GLState::ISSUED_COUNTS[STATE_COUNTER_VIEWPORT]++;
+
+	glViewport(x, y, width, height);
+}
+
+void Knee::GLState::setEnabled(GLenum capability, bool enabled){
+	std::map<GLenum, bool>::iterator it = Knee::GLState::CAPABILITIES.find(capability);
+
+	if(it != Knee::GLState::CAPABILITIES.end() && it->second == enabled){
+		Knee::GLState::SKIPPED_COUNTS[STATE_COUNTER_CAPABILITY]++;
+		return;
+	}
+
+	Knee::GLState::CAPABILITIES[capability] = enabled;
+	Knee::GLState::ISSUED_COUNTS[STATE_COUNTER_CAPABILITY]++;
+
+	if(enabled){
+		glEnable(capability);
+	}else{
+		glDisable(capability);
+	}
+}
+
+void Knee::GLState::enable(GLenum capability){
+	Knee::GLState::setEnabled(capability, true);
+}
+
+void Knee::GLState::disable(GLenum capability){
+	Knee::GLState::setEnabled(capability, false);
+}
+
+void Knee::GLState::setDepthFunc(GLenum func){
+	if(!Knee::GLState::change(STATE_COUNTER_DEPTH, Knee::GLState::DEPTH_FUNC, func)) return;
+
+	glDepthFunc(func);
+}
+
+void Knee::GLState::setDepthMask(bool mask){
+	if(!Knee::GLState::change(STATE_COUNTER_DEPTH, Knee::GLState::DEPTH_MASK, mask ? GL_TRUE : GL_FALSE)) return;
+
+	glDepthMask(mask ? GL_TRUE : GL_FALSE);
+}
+
+void Knee::GLState::setDepthRange(GLfloat nearValue, GLfloat farValue){
+	// an unknown range is NAN, which never compares equal
+	if(Knee::GLState::DEPTH_RANGE[0] == nearValue && Knee::GLState::DEPTH_RANGE[1] == farValue){
+		Knee::GLState::SKIPPED_COUNTS[STATE_COUNTER_DEPTH]++;
+		return;
+	}
+
+	Knee::GLState::DEPTH_RANGE[0] = nearValue;
+	Knee::GLState::DEPTH_RANGE[1] = farValue;
+
+	Knee::GLState::ISSUED_COUNTS[STATE_COUNTER_DEPTH]++;
+
+	glDepthRange(nearValue, farValue);
+}
+
+void Knee::GLState::setStencilFunc(GLenum func, GLint ref, GLuint mask){
+	GLuint values[3] = { func, (GLuint)ref, mask };
+
+	if(!Knee::GLState::change(STATE_COUNTER_STENCIL, Knee::GLState::STENCIL_FUNC, values, 3)) return;
+
+	glStencilFunc(func, ref, mask);
+}
+
+void Knee::GLState::setStencilOp(GLenum stencilFail, GLenum depthFail, GLenum depthPass){
+	GLuint values[3] = { stencilFail, depthFail, depthPass };
+
+	if(!Knee::GLState::change(STATE_COUNTER_STENCIL, Knee::GLState::STENCIL_OP, values, 3)) return;
+
+	glStencilOp(stencilFail, depthFail, depthPass);
+}
+
+void Knee::GLState::setStencilMask(GLuint mask){
+	if(!Knee::GLState::change(STATE_COUNTER_STENCIL, Knee::GLState::STENCIL_MASK, mask)) return;
+
+	glStencilMask(mask);
+}
+
+void Knee::GLState::setScissor(GLint x, GLint y, GLsizei width, GLsizei height){
+	GLuint values[4] = { (GLuint)x, (GLuint)y, (GLuint)width, (GLuint)height };
+
+	if(!Knee::GLState::change(STATE_COUNTER_SCISSOR, (GLuint*)Knee::GLState::SCISSOR, values, 4)) return;
+
+	glScissor(x, y, width, height);
+}
+
+void Knee::GLState::setColorMask(bool mask){
+	if(!Knee::GLState::change(STATE_COUNTER_COLOR_MASK, Knee::GLState::COLOR_MASK, mask ? GL_TRUE : GL_FALSE)) return;
+
+	GLboolean value = mask ? GL_TRUE : GL_FALSE;
+
+	glColorMask(value, value, value, value);
+}
+
+void Knee::GLState::deleteProgram(GLuint program){
+	glDeleteProgram(program);
+
+	if(Knee::GLState::PROGRAM == program) Knee::GLState::PROGRAM = 0;
+}
+
+void Knee::GLState::deleteVertexArray(GLuint vertexArray){
+	glDeleteVertexArrays(1, &vertexArray);
+
+	if(Knee::GLState::VERTEX_ARRAY == vertexArray) Knee::GLState::VERTEX_ARRAY = 0;
+}
+
+void Knee::GLState::deleteTexture(GLuint texture){
+	glDeleteTextures(1, &texture);
+
+	for(uint32_t i = 0; i < Knee::GLState::MAX_TRACKED_TEXTURE_UNITS; i++){
+		for(uint32_t j = 0; j < Knee::GLState::TEXTURE_TARGET_COUNT; j++){
+			if(Knee::GLState::TEXTURES[i][j] == texture) Knee::GLState::TEXTURES[i][j] = 0;
+		}
+	}
+}
+
+void Knee::GLState::deleteFramebuffer(GLuint framebuffer){
+	glDeleteFramebuffers(1, &framebuffer);
+
+	if(Knee::GLState::DRAW_FRAMEBUFFER == framebuffer) Knee::GLState::DRAW_FRAMEBUFFER = 0;
+	if(Knee::GLState::READ_FRAMEBUFFER == framebuffer) Knee::GLState::READ_FRAMEBUFFER = 0;
+}
+
+uint64_t Knee::GLState::getIssuedCount(Knee::GLStateCounter counter){
+	return Knee::GLState::ISSUED_COUNTS[counter];
+}
+
+uint64_t Knee::GLState::getSkippedCount(Knee::GLStateCounter counter){
+	return Knee::GLState::SKIPPED_COUNTS[counter];
+}
+
+void Knee::GLState::resetCounters(){
+	for(uint32_t i = 0; i < STATE_COUNTER_COUNT; i++){
+		Knee::GLState::ISSUED_COUNTS[i] = 0;
+		Knee::GLState::SKIPPED_COUNTS[i] = 0;
+	}
+}
@@ -0,0 +1,523 @@
+#include <NonEuclideanEngine/mesh.hpp>
+
+#include <algorithm>
+#include <map>
+#include <tuple>
+#include <utility>
+#include <cmath>
+
+// -------------------- //
+// MeshSimplifier //
+
+void Knee::MeshSimplifier::Quadric::addPlane(glm::vec3 normal, float distance, double weight){
+	double a = normal.x;
+	double b = normal.y;
+	double c = normal.z;
+	double d = distance;
+
+	this->m[0] += weight * a*a;
+	this->m[1] += weight * a*b;
+	this->m[2] += weight * a*c;
+	this->m[3] += weight * a*d;
+	this->m[4] += weight * b*b;
+	this->m[5] += weight * b*c;
+	this->m[6] += weight * b*d;
+	this->m[7] += weight * c*c;
+	this->m[8] += weight * c*d;
+	this->m[9] += weight * d*d;
+
+	this->weight += weight;
+}
+
+void Knee::MeshSimplifier::Quadric::add(const Knee::MeshSimplifier::Quadric& other){
+	for(uint32_t i = 0; i < 10; i++){
+		this->m[i] += other.m[i];
+	}
+
+	this->weight += other.weight;
+}
+
+double Knee::MeshSimplifier::Quadric::evaluate(glm::vec3 p) const {
+	double x = p.x;
+	double y = p.y;
+	double z = p.z;
+
+	double sum = this->m[0]*x*x + 2*this->m[1]*x*y + 2*this->m[2]*x*z + 2*this->m[3]*x
+		+ this->m[4]*y*y + 2*this->m[5]*y*z + 2*this->m[6]*y
+		+ this->m[7]*z*z + 2*this->m[8]*z
+		+ this->m[9];
+
+	if(this->weight <= 0.0) return 0.0;
+
+	// rounding can leave the sum slightly negative
+	return std::max(sum, 0.0) / this->weight;
+}
+
+void Knee::MeshSimplifier::generateLODs(const float* data, uint32_t vertexCount, uint32_t stride, uint32_t positionOffset, uint32_t levelCount, std::vector<Knee::MeshLOD>& lods){
+	lods.clear();
+
+	if(levelCount == 0 || vertexCount < 3) return;
+
+	Knee::MeshSimplifier::State state;
+
+	Knee::MeshSimplifier::weld(data, vertexCount, stride, positionOffset, state);
+	Knee::MeshSimplifier::addQuadrics(state);
+
+	for(uint32_t i = 0; i < state.positions.size(); i++){
+		Knee::MeshSimplifier::addCollapses(state, i);
+	}
+
+	uint32_t levelTriangles = state.triangleCount;
+	uint32_t target = levelTriangles / 2;
+
+	// the most expensive collapse so far is about how far the surface has moved
+	double maxCost = 0.0;
+
+	while(!state.collapses.empty() && lods.size() < levelCount && state.triangleCount > Knee::MeshSimplifier::MIN_TRIANGLES){
+		std::pop_heap(state.collapses.begin(), state.collapses.end(), Knee::MeshSimplifier::compareCost);
+
+		Knee::MeshSimplifier::Collapse collapse = state.collapses.back();
+		state.collapses.pop_back();
+
+		// one of the positions has changed since this was added
+		if(state.removed.at(collapse.from) || state.removed.at(collapse.to)) continue;
+		if(state.versions.at(collapse.from) != collapse.fromVersion || state.versions.at(collapse.to) != collapse.toVersion) continue;
+
+		if(!Knee::MeshSimplifier::canCollapse(state, collapse.from, collapse.to)) continue;
+
+		Knee::MeshSimplifier::collapse(state, collapse.from, collapse.to);
+
+		maxCost = std::max(maxCost, collapse.cost);
+
+		if(state.triangleCount > target) continue;
+
+		lods.push_back(Knee::MeshLOD());
+		Knee::MeshSimplifier::getLOD(state, data, stride, positionOffset, lods.back());
+		lods.back().error = (float)sqrt(maxCost);
+
+		levelTriangles = state.triangleCount;
+		target = levelTriangles / 2;
+	}
+
+	// whatever's left once nothing else can be collapsed is still worth keeping if it's simple enough
+	if(lods.size() < levelCount && state.triangleCount <= levelTriangles * Knee::MeshSimplifier::MAX_LEVEL_TRIANGLE_FRACTION){
+		lods.push_back(Knee::MeshLOD());
+		Knee::MeshSimplifier::getLOD(state, data, stride, positionOffset, lods.back());
+		lods.back().error = (float)sqrt(maxCost);
+	}
+}
+
+void Knee::MeshSimplifier::weld(const float* data, uint32_t vertexCount, uint32_t stride, uint32_t positionOffset, Knee::MeshSimplifier::State& state){
+	std::map<std::tuple<float, float, float>, uint32_t> welded;
+
+	std::vector<uint32_t> vertexPositions(vertexCount);
+
+	for(uint32_t i = 0; i < vertexCount; i++){
+		const float* p = data + i*stride + positionOffset;
+
+		std::tuple<float, float, float> key(p[0], p[1], p[2]);
+		std::map<std::tuple<float, float, float>, uint32_t>::iterator it = welded.find(key);
+
+		if(it == welded.end()){
+			it = welded.insert(std::make_pair(key, (uint32_t)state.positions.size())).first;
+
+			state.positions.push_back(glm::vec3(p[0], p[1], p[2]));
+		}
+
+		vertexPositions.at(i) = it->second;
+	}
+
+	state.quadrics.resize(state.positions.size());
+	state.versions.resize(state.positions.size(), 0);
+	state.removed.resize(state.positions.size(), false);
+	state.positionTriangles.resize(state.positions.size());
+
+	for(uint32_t i = 0; i + 2 < vertexCount; i += 3){
+		Knee::MeshSimplifier::Triangle triangle;
+
+		for(uint32_t j = 0; j < 3; j++){
+			triangle.positions[j] = vertexPositions.at(i + j);
+			triangle.vertices[j] = i + j;
+		}
+
+		// already degenerate after welding
+		if(triangle.positions[0] == triangle.positions[1] || triangle.positions[1] == triangle.positions[2] || triangle.positions[2] == triangle.positions[0]) continue;
+
+		for(uint32_t j = 0; j < 3; j++){
+			state.positionTriangles.at(triangle.positions[j]).push_back(state.triangles.size());
+		}
+
+		state.triangles.push_back(triangle);
+	}
+
+	state.triangleCount = state.triangles.size();
+}
+
+void Knee::MeshSimplifier::addQuadrics(Knee::MeshSimplifier::State& state){
+	// how many triangles use each edge, along with the last one that did
+	std::map<std::pair<uint32_t, uint32_t>, std::pair<uint32_t, uint32_t>> edges;
+
+	for(uint32_t i = 0; i < state.triangles.size(); i++){
+		const Knee::MeshSimplifier::Triangle& triangle = state.triangles.at(i);
+
+		glm::vec3 a = state.positions.at(triangle.positions[0]);
+		glm::vec3 b = state.positions.at(triangle.positions[1]);
+		glm::vec3 c = state.positions.at(triangle.positions[2]);
+
+		glm::vec3 normal = glm::cross(b - a, c - a);
+
+		if(glm::length(normal) == 0.0f) continue;
+
+		normal = glm::normalize(normal);
+
+		// every corner wants to stay on the triangle's plane
+		for(uint32_t j = 0; j < 3; j++){
+			state.quadrics.at(triangle.positions[j]).addPlane(normal, -glm::dot(normal, a), 1.0);
+		}
+
+		for(uint32_t j = 0; j < 3; j++){
+			uint32_t start = triangle.positions[j];
+			uint32_t end = triangle.positions[(j + 1) % 3];
+
+			std::pair<uint32_t, uint32_t>& edge = edges[std::make_pair(std::min(start, end), std::max(start, end))];
+
+			edge.first++;
+			edge.second = i;
+		}
+	}
+
+	// edges used by only one triangle are on a border, so keep them on a plane running along the edge perpendicular to the triangle
+	for(std::map<std::pair<uint32_t, uint32_t>, std::pair<uint32_t, uint32_t>>::iterator it = edges.begin(); it != edges.end(); ++it){
+		if(it->second.first != 1) continue;
+
+		const Knee::MeshSimplifier::Triangle& triangle = state.triangles.at(it->second.second);
+
+		glm::vec3 a = state.positions.at(triangle.positions[0]);
+		glm::vec3 b = state.positions.at(triangle.positions[1]);
+		glm::vec3 c = state.positions.at(triangle.positions[2]);
+
+		glm::vec3 start = state.positions.at(it->first.first);
+		glm::vec3 end = state.positions.at(it->first.second);
+
+		glm::vec3 normal = glm::cross(end - start, glm::cross(b - a, c - a));
+
+		if(glm::length(normal) == 0.0f) continue;
+
+		normal = glm::normalize(normal);
+
+		state.quadrics.at(it->first.first).addPlane(normal, -glm::dot(normal, start), Knee::MeshSimplifier::BOUNDARY_WEIGHT);
+		state.quadrics.at(it->first.second).addPlane(normal, -glm::dot(normal, start), Knee::MeshSimplifier::BOUNDARY_WEIGHT);
+	}
+}
+
+void Knee::MeshSimplifier::addCollapses(Knee::MeshSimplifier::State& state, uint32_t position){
+	const std::vector<uint32_t>& triangles = state.positionTriangles.at(position);
+
+	for(uint32_t i = 0; i < triangles.size(); i++){
+		const Knee::MeshSimplifier::Triangle& triangle = state.triangles.at(triangles.at(i));
+
+		if(triangle.removed) continue;
+
+		for(uint32_t j = 0; j < 3; j++){
+			uint32_t other = triangle.positions[j];
+
+			if(other == position) continue;
+
+			// positions are kept where they are, so moving one onto the other costs the combined error at the other's position
+			Knee::MeshSimplifier::Quadric quadric = state.quadrics.at(position);
+			quadric.add(state.quadrics.at(other));
+
+			double toOther = quadric.evaluate(state.positions.at(other));
+			double toPosition = quadric.evaluate(state.positions.at(position));
+
+			Knee::MeshSimplifier::Collapse collapse;
+
+			if(toOther <= toPosition){
+				collapse.cost = toOther;
+				collapse.from = position;
+				collapse.to = other;
+			} else {
+				collapse.cost = toPosition;
+				collapse.from = other;
+				collapse.to = position;
+			}
+
+			collapse.fromVersion = state.versions.at(collapse.from);
+			collapse.toVersion = state.versions.at(collapse.to);
+
+			state.collapses.push_back(collapse);
+			std::push_heap(state.collapses.begin(), state.collapses.end(), Knee::MeshSimplifier::compareCost);
+		}
+	}
+}
+
+bool Knee::MeshSimplifier::compareCost(const Knee::MeshSimplifier::Collapse& a, const Knee::MeshSimplifier::Collapse& b){
+	return a.cost > b.cost;
+}
+
+bool Knee::MeshSimplifier::canCollapse(Knee::MeshSimplifier::State& state, uint32_t from, uint32_t to){
+	const std::vector<uint32_t>& triangles = state.positionTriangles.at(from);
+
+	// triangles the collapse would remove
+	uint32_t removedCount = 0;
+
+	for(uint32_t i = 0; i < triangles.size(); i++){
+		const Knee::MeshSimplifier::Triangle& triangle = state.triangles.at(triangles.at(i));
+
+		if(triangle.removed) continue;
+
+		glm::vec3 before[3];
+		glm::vec3 after[3];
+		bool shared = false;
+
+		for(uint32_t j = 0; j < 3; j++){
+			before[j] = state.positions.at(triangle.positions[j]);
+			after[j] = triangle.positions[j] == from ? state.positions.at(to) : before[j];
+
+			shared = shared || triangle.positions[j] == to;
+		}
+
+		// triangles on the edge itself are removed
+		if(shared){
+			removedCount++;
+			continue;
+		}
+
+		glm::vec3 normalBefore = glm::cross(before[1] - before[0], before[2] - before[0]);
+		glm::vec3 normalAfter = glm::cross(after[1] - after[0], after[2] - after[0]);
+
+		if(glm::dot(normalBefore, normalAfter) <= 0.0f) return false;
+	}
+
+	// a collapse can remove several triangles at once, which mustn't take the mesh below the minimum
+	if(state.triangleCount - removedCount < Knee::MeshSimplifier::MIN_TRIANGLES) return false;
+
+	return true;
+}
+
+void Knee::MeshSimplifier::collapse(Knee::MeshSimplifier::State& state, uint32_t from, uint32_t to){
+	std::vector<uint32_t>& triangles = state.positionTriangles.at(from);
+
+	for(uint32_t i = 0; i < triangles.size(); i++){
+		Knee::MeshSimplifier::Triangle& triangle = state.triangles.at(triangles.at(i));
+
+		if(triangle.removed) continue;
+
+		if(triangle.positions[0] == to || triangle.positions[1] == to || triangle.positions[2] == to){
+			triangle.removed = true;
+			state.triangleCount--;
+
+			continue;
+		}
+
+		for(uint32_t j = 0; j < 3; j++){
+			if(triangle.positions[j] == from) triangle.positions[j] = to;
+		}
+
+		state.positionTriangles.at(to).push_back(triangles.at(i));
+	}
+
+	triangles.clear();
+
+	state.quadrics.at(to).add(state.quadrics.at(from));
+	state.removed.at(from) = true;
+	state.versions.at(to)++;
+
+	// every edge around the position now has a different cost
+	Knee::MeshSimplifier::addCollapses(state, to);
+}
+
+void Knee::MeshSimplifier::getLOD(const Knee::MeshSimplifier::State& state, const float* data, uint32_t stride, uint32_t positionOffset, Knee::MeshLOD& lod){
+	lod.data.clear();
+	lod.data.reserve(state.triangleCount * 3 * stride);
+
+	for(uint32_t i = 0; i < state.triangles.size(); i++){
+		const Knee::MeshSimplifier::Triangle& triangle = state.triangles.at(i);
+
+		if(triangle.removed) continue;
+
+		for(uint32_t j = 0; j < 3; j++){
+			// keep the corner's own attributes, just moved to wherever its position ended up
+			const float* vertex = data + triangle.vertices[j]*stride;
+
+			lod.data.insert(lod.data.end(), vertex, vertex + stride);
+
+			glm::vec3 p = state.positions.at(triangle.positions[j]);
+			float* out = lod.data.data() + lod.data.size() - stride + positionOffset;
+
+			out[0] = p.x;
+			out[1] = p.y;
+			out[2] = p.z;
+		}
+	}
+
+	lod.vertexCount = state.triangleCount * 3;
+}
+
+// -------------------- //
+// MeshIndexer //
+
+void Knee::MeshIndexer::index(const float* data, uint32_t vertexCount, uint32_t stride, std::vector<float>& vertices, std::vector<uint32_t>& indices){
+	vertices.clear();
+	indices.resize(vertexCount);
+
+	std::map<std::vector<float>, uint32_t> unique;
+
+	for(uint32_t i = 0; i < vertexCount; i++){
+		std::vector<float> key(data + i*stride, data + (i + 1)*stride);
+		std::map<std::vector<float>, uint32_t>::iterator it = unique.find(key);
+
+		if(it == unique.end()){
+			it = unique.insert(std::make_pair(key, (uint32_t)(vertices.size() / std::max(stride, 1u)))).first;
+
+			vertices.insert(vertices.end(), key.begin(), key.end());
+		}
+
+		indices.at(i) = it->second;
+	}
+}
+
+void Knee::MeshIndexer::optimizeVertexCache(std::vector<uint32_t>& indices, uint32_t vertexCount){
+	uint32_t triangleCount = indices.size() / 3;
+
+	if(triangleCount < 2) return;
+
+	Knee::MeshIndexer::CacheState state;
+
+	// find the triangles around each vertex
+	state.triangleOffsets.resize(vertexCount + 1, 0);
+	state.liveTriangles.resize(vertexCount, 0);
+
+	for(uint32_t i = 0; i < triangleCount * 3; i++){
+		state.liveTriangles.at(indices.at(i))++;
+	}
+
+	for(uint32_t i = 0; i < vertexCount; i++){
+		state.triangleOffsets.at(i + 1) = state.triangleOffsets.at(i) + state.liveTriangles.at(i);
+	}
+
+	state.vertexTriangles.resize(triangleCount * 3);
+
+	std::vector<uint32_t> filled(state.triangleOffsets.begin(), state.triangleOffsets.end() - 1);
+
+	for(uint32_t i = 0; i < triangleCount * 3; i++){
+		state.vertexTriangles.at(filled.at(indices.at(i))++) = i / 3;
+	}
+
+	// nothing starts in the cache
+	state.cacheTimes.resize(vertexCount, 0);
+	state.timestamp = Knee::MeshIndexer::VERTEX_CACHE_SIZE + 1;
+
+	std::vector<bool> emitted(triangleCount, false);
+	std::vector<uint32_t> optimized;
+	std::vector<uint32_t> candidates;
+
+	optimized.reserve(triangleCount * 3);
+
+	int32_t fanVertex = 0;
+
+	while(fanVertex >= 0){
+		candidates.clear();
+
+		// emit every triangle around the vertex that hasn't been yet
+		for(uint32_t i = state.triangleOffsets.at(fanVertex); i < state.triangleOffsets.at(fanVertex + 1); i++){
+			uint32_t triangle = state.vertexTriangles.at(i);
+
+			if(emitted.at(triangle)) continue;
+
+			for(uint32_t j = 0; j < 3; j++){
+				uint32_t vertex = indices.at(triangle*3 + j);
+
+				optimized.push_back(vertex);
+				state.deadEnds.push_back(vertex);
+				candidates.push_back(vertex);
+
+				state.liveTriangles.at(vertex)--;
+
+				// a miss puts the vertex back in the cache
+				if(state.timestamp - state.cacheTimes.at(vertex) > Knee::MeshIndexer::VERTEX_CACHE_SIZE){
+					state.cacheTimes.at(vertex) = state.timestamp++;
+				}
+			}
+
+			emitted.at(triangle) = true;
+		}
+
+		fanVertex = Knee::MeshIndexer::getNextVertex(state, candidates);
+	}
+
+	// a trailing partial triangle is never drawn, but is kept so the index count doesn't change
+	optimized.insert(optimized.end(), indices.begin() + triangleCount * 3, indices.end());
+
+	indices.swap(optimized);
+}
+
+int32_t Knee::MeshIndexer::getNextVertex(Knee::MeshIndexer::CacheState& state, const std::vector<uint32_t>& candidates){
+	int32_t best = -1;
+	int32_t bestPriority = -1;
+
+	for(uint32_t i = 0; i < candidates.size(); i++){
+		uint32_t vertex = candidates.at(i);
+
+		if(state.liveTriangles.at(vertex) == 0) continue;
+
+		// the oldest vertex that will still be in the cache once its remaining triangles are emitted, which fans out as far as possible before it's lost
+		int32_t priority = 0;
+		uint32_t age = state.timestamp - state.cacheTimes.at(vertex);
+
+		if(age + 2*state.liveTriangles.at(vertex) <= Knee::MeshIndexer::VERTEX_CACHE_SIZE) priority = age;
+
+		if(priority > bestPriority){
+			bestPriority = priority;
+			best = vertex;
+		}
+	}
+
+	if(best < 0) return Knee::MeshIndexer::skipDeadEnd(state);
+
+	return best;
+}
+
+int32_t Knee::MeshIndexer::skipDeadEnd(Knee::MeshIndexer::CacheState& state){
+	// something recently used is likely to still be in the cache
+	while(!state.deadEnds.empty()){
+		uint32_t vertex = state.deadEnds.back();
+		state.deadEnds.pop_back();
+
+		if(state.liveTriangles.at(vertex) > 0) return vertex;
+	}
+
+	// otherwise start again at the next vertex with triangles left
+	for(; state.cursor < state.liveTriangles.size(); state.cursor++){
+		if(state.liveTriangles.at(state.cursor) > 0) return state.cursor;
+	}
+
+	return -1;
+}
+
+void Knee::MeshIndexer::optimizeVertexFetch(std::vector<float>& vertices, uint32_t stride, std::vector<uint32_t>& indices){
+	if(stride == 0) return;
+
+	uint32_t vertexCount = vertices.size() / stride;
+
+	const uint32_t UNUSED = 0xFFFFFFFF;
+	std::vector<uint32_t> remap(vertexCount, UNUSED);
+
+	std::vector<float> reordered;
+	reordered.reserve(vertices.size());
+
+	for(uint32_t i = 0; i < indices.size(); i++){
+		uint32_t vertex = indices.at(i);
+
+		if(remap.at(vertex) == UNUSED){
+			remap.at(vertex) = reordered.size() / stride;
+
+			reordered.insert(reordered.end(), vertices.begin() + vertex*stride, vertices.begin() + (vertex + 1)*stride);
+		}
+
+		indices.at(i) = remap.at(vertex);
+	}
+
+	// vertices that no triangle uses are dropped
+	vertices.swap(reordered);
+}
@@ -51,6 +51,8 @@ void Knee::DeltaTimer::pauseThread(double seconds){
 // -------------------- //
 // GeneralObject //
 
+uint64_t Knee::GeneralObject::LATEST_TRANSFORM_VERSION = 0;
+
 // constructors //
 
 Knee::GeneralObject::GeneralObject(){}
@@ -337,6 +339,169 @@ glm::mat4 Knee::GeneralObject::getModelMatrix(){
 void Knee::GeneralObject::updateModelMatrix(){
 	// update through precalculated transformation matrices
 	this->m_modelMatrix = this->getTranslationMatrix() * this->getRotationMatrix()  * this->getScaleMatrix();
+
+	// every change goes through here
+	this->m_transformVersion = ++Knee::GeneralObject::LATEST_TRANSFORM_VERSION;
+}
+
+// change tracking //
+
+uint64_t Knee::GeneralObject::getTransformVersion() const {
+	return this->m_transformVersion;
+}
+
+uint64_t Knee::GeneralObject::getLatestTransformVersion(){
+	return Knee::GeneralObject::LATEST_TRANSFORM_VERSION;
+}
+
+// -------------------- //
+// ScreenRect //
+
+Knee::ScreenRect::ScreenRect(){}
+
+Knee::ScreenRect::ScreenRect(glm::vec2 min, glm::vec2 max) : m_min(min), m_max(max) {}
+
+glm::vec2 Knee::ScreenRect::getMin() const { return this->m_min; }
+glm::vec2 Knee::ScreenRect::getMax() const { return this->m_max; }
+glm::vec2 Knee::ScreenRect::getSize() const { return this->m_max - this->m_min; }
+glm::vec2 Knee::ScreenRect::getCenter() const { return (this->m_min + this->m_max) / 2.f; }
+
+bool Knee::ScreenRect::isEmpty() const {
+	return this->m_max.x <= this->m_min.x || this->m_max.y <= this->m_min.y;
+}
+
+Knee::ScreenRect Knee::ScreenRect::intersection(const ScreenRect& other) const {
+	return Knee::ScreenRect(glm::max(this->m_min, other.getMin()), glm::min(this->m_max, other.getMax()));
+}
+
+Knee::ScreenRect Knee::ScreenRect::snappedToPixels(uint32_t screenWidth, uint32_t screenHeight) const {
+	if(this->isEmpty()) return *this;
+
+	glm::vec2 screenSize = glm::vec2(screenWidth, screenHeight);
+
+	// NDC -> pixels, round outwards, then back
+	glm::vec2 min = glm::floor((this->m_min*0.5f + 0.5f) * screenSize);
+	glm::vec2 max = glm::ceil((this->m_max*0.5f + 0.5f) * screenSize);
+
+	return Knee::ScreenRect((min / screenSize)*2.f - 1.f, (max / screenSize)*2.f - 1.f);
+}
+
+glm::vec2 Knee::ScreenRect::getPixelSize(uint32_t screenWidth, uint32_t screenHeight) const {
+	if(this->isEmpty()) return glm::vec2(0);
+
+	return this->getSize() * 0.5f * glm::vec2(screenWidth, screenHeight);
+}
+
+glm::mat4 Knee::ScreenRect::getCropMatrix() const {
+	glm::vec2 scale = 2.f / this->getSize();
+	glm::vec2 offset = -this->getCenter() * scale;
+
+	glm::mat4 out = glm::mat4(1);
+
+	out[0][0] = scale.x;
+	out[1][1] = scale.y;
+	out[3][0] = offset.x;
+	out[3][1] = offset.y;
+
+	return out;
+}
+
+glm::mat3 Knee::ScreenRect::getSampleTransform(const ScreenRect& drawnIn) const {
+	// undo the crop of the view being drawn in to get uncropped NDC, then find where that lies within this rectangle
+	glm::vec2 scale = (drawnIn.getSize() / 2.f) / this->getSize();
+	glm::vec2 offset = (drawnIn.getCenter() - this->m_min) / this->getSize();
+
+	glm::mat3 out = glm::mat3(1);
+
+	out[0][0] = scale.x;
+	out[1][1] = scale.y;
+	out[2][0] = offset.x;
+	out[2][1] = offset.y;
+
+	return out;
+}
+
+glm::mat3 Knee::ScreenRect::getUncropTransform() const {
+	glm::mat3 out = glm::mat3(1);
+
+	out[0][0] = this->getSize().x / 2.f;
+	out[1][1] = this->getSize().y / 2.f;
+	out[2][0] = this->getCenter().x;
+	out[2][1] = this->getCenter().y;
+
+	return out;
+}
+
+// -------------------- //
+// Frustum //
+
+Knee::Frustum::Frustum(){}
+
+Knee::Frustum::Frustum(glm::mat4 viewProjection){
+	// https://www.gamedevs.org/uploads/fast-extraction-viewing-frustum-planes-from-world-view-projection-matrix.pdf
+	glm::vec4 rows[4];
+
+	for(uint32_t i = 0; i < 4; i++){
+		rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+	}
+
+	glm::vec4 planes[] = {
+		rows[3] + rows[0], // left
+		rows[3] - rows[0], // right
+		rows[3] + rows[1], // bottom
+		rows[3] - rows[1], // top
+		rows[3] + rows[2], // near
+		rows[3] - rows[2]  // far
+	};
+
+	for(uint32_t i = 0; i < 6; i++){
+		float length = glm::length(glm::vec3(planes[i]));
+
+		if(length <= 0) continue;
+
+		this->m_planes.push_back(planes[i] / length);
+	}
+}
+
+void Knee::Frustum::addPlane(glm::vec3 point, glm::vec3 normal){
+	float length = glm::length(normal);
+
+	// degenerate plane, can't reject anything
+	if(length <= 1e-6f) return;
+
+	normal /= length;
+
+	this->m_planes.push_back(glm::vec4(normal, -glm::dot(normal, point)));
+}
+
+void Knee::Frustum::addQuadPlanes(glm::vec3 eye, const glm::vec3 quad[4]){
+	glm::vec3 center = (quad[0] + quad[1] + quad[2] + quad[3]) / 4.f;
+
+	for(uint32_t i = 0; i < 4; i++){
+		glm::vec3 a = quad[i];
+		glm::vec3 b = quad[(i+1)%4];
+
+		glm::vec3 normal = glm::cross(a - eye, b - eye);
+
+		// point towards the middle of the quad
+		if(glm::dot(normal, center - eye) < 0) normal = -normal;
+
+		this->addPlane(eye, normal);
+	}
+}
+
+uint32_t Knee::Frustum::getPlaneCount(){
+	return this->m_planes.size();
+}
+
+bool Knee::Frustum::intersectsSphere(glm::vec3 center, float radius) const {
+	for(uint32_t i = 0; i < this->m_planes.size(); i++){
+		const glm::vec4& plane = this->m_planes[i];
+
+		if(glm::dot(glm::vec3(plane), center) + plane.w < -radius) return false;
+	}
+
+	return true;
 }
 
 // -------------------- //
@@ -466,4 +631,43 @@ bool Knee::MathUtils::lineSegmentIntersectingOrWithinAABB(
 
 	// no intersection :(
 	return false;
+}
+
+bool Knee::MathUtils::computeHomography(const glm::vec2 from[4], const glm::vec2 to[4], glm::mat3& homography){
+	glm::mat3 squareToFrom;
+	glm::mat3 squareToTo;
+
+	if(!Knee::MathUtils::computeSquareToQuad(from, squareToFrom)) return false;
+	if(!Knee::MathUtils::computeSquareToQuad(to, squareToTo)) return false;
+
+	// from -> unit square -> to
+	homography = squareToTo * glm::inverse(squareToFrom);
+
+	return true;
+}
+
+bool Knee::MathUtils::computeSquareToQuad(const glm::vec2 quad[4], glm::mat3& transform){
+	glm::vec2 d1 = quad[1] - quad[2];
+	glm::vec2 d2 = quad[3] - quad[2];
+	glm::vec2 d3 = quad[0] - quad[1] + quad[2] - quad[3];
+
+	float g = 0;
+	float h = 0;
+
+	// a parallelogram only needs an affine transformation, anything else is projective
+	if(d3.x != 0 || d3.y != 0){
+		float det = d1.x * d2.y - d2.x * d1.y;
+
+		if(det == 0) return false;
+
+		g = (d3.x * d2.y - d2.x * d3.y) / det;
+		h = (d1.x * d3.y - d3.x * d1.y) / det;
+	}
+
+	// columns of the matrix, so (u, v, 1) maps to (x*w, y*w, w)
+	transform[0] = glm::vec3(quad[1] - quad[0] + g * quad[1], g);
+	transform[1] = glm::vec3(quad[3] - quad[0] + h * quad[3], h);
+	transform[2] = glm::vec3(quad[0], 1);
+
+	return glm::determinant(transform) != 0;
 }
\ No newline at end of file
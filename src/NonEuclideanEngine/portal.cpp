@@ -1,13 +1,17 @@
 #include <NonEuclideanEngine/shader.hpp>
 #include <NonEuclideanEngine/portal.hpp>
 #include <NonEuclideanEngine/player.hpp>
+#include <NonEuclideanEngine/cell.hpp>
+#include <NonEuclideanEngine/glstate.hpp>
 
 #include <iostream>
+#include <algorithm>
+#include <cmath>
 
 // -------------------- //
 // VisualPortal //
 
-Knee::VisualPortal::VisualPortal(Knee::VertexData* vertexData, uint32_t screenWidth, uint32_t screenHeight) : 
+Knee::VisualPortal::VisualPortal(Knee::VertexData* vertexData) : 
 	RenderableStaticGameObject(
 		vertexData,
 		NULL
@@ -15,18 +19,12 @@ Knee::VisualPortal::VisualPortal(Knee::VertexData* vertexData, uint32_t screenWi
 {
 	// texture is unassigned until loadPortalTexture is called
 	this->m_texture = NULL;
-
-	// create framebuffers
-	this->m_mainFramebuffer = new Knee::Framebuffer2D(screenWidth, screenHeight);
-	this->m_auxFramebuffer = new Knee::Framebuffer2D(screenWidth, screenHeight);
 };
 
 Knee::VisualPortal::~VisualPortal(){
-	// free main texture
-	delete this->m_mainFramebuffer;
-
-	// free aux texture
-	delete this->m_auxFramebuffer;
+	if(this->m_occlusionQuery != 0){
+		glDeleteQueries(1, &this->m_occlusionQuery);
+	}
 }
 
 Knee::RenderableStaticGameObject* Knee::VisualPortal::asRenderableStaticGameObject(){
@@ -38,6 +36,10 @@ void Knee::VisualPortal::pair(Knee::VisualPortal* portal){
 	this->m_pair = portal;
 }
 
+Knee::VisualPortal* Knee::VisualPortal::getPair(){
+	return this->m_pair;
+}
+
 Knee::GeneralObject Knee::VisualPortal::getPairSpaceTransformation(){
 	Knee::GeneralObject out = *this->m_pair->asGeneralObject() * this->asGeneralObject()->getInverseGeneralObject();
 
@@ -66,216 +68,662 @@ void Knee::VisualPortal::getVertices(glm::vec3& topLeft, glm::vec3& topRight, gl
 	bottomRight += this->getPosition();
 }
 
-bool Knee::VisualPortal::isVisible(Knee::PerspectiveCamera* camera){
-	// get portal vertices
-	glm::vec3 vertices[4];
+void Knee::VisualPortal::getCorners(const std::vector<Knee::VisualPortal*>& portals, std::vector<glm::vec3>& corners){
+	corners.resize(portals.size() * 4);
 
-	this->getVertices(vertices[0], vertices[1], vertices[3], vertices[2]);
+	for(uint32_t i = 0; i < portals.size(); i++){
+		// in order around the edge
+		portals.at(i)->getVertices(corners[i*4 + 0], corners[i*4 + 1], corners[i*4 + 3], corners[i*4 + 2]);
+	}
+}
 
-	glm::vec3 ndc[4];
+void Knee::VisualPortal::getScreenBounds(glm::mat4 viewProjection, const std::vector<glm::vec3>& corners, std::vector<Knee::PortalScreenBounds>& bounds){
+	uint32_t cornerCount = corners.size();
 
-	// transform to NDC and check for visiblity
-	for(uint32_t i = 0; i < 4; i++){
-		glm::vec4 v = camera->getViewProjectionMatrix() * glm::vec4(vertices[i], 1);
+	// transform every corner to clip space at once
+	// kept as flat loops over separate arrays so that the compiler can vectorize them
+	std::vector<float> x(cornerCount);
+	std::vector<float> y(cornerCount);
+	std::vector<float> z(cornerCount);
+	std::vector<float> w(cornerCount);
+
+	for(uint32_t i = 0; i < cornerCount; i++){
+		const glm::vec3& p = corners[i];
+
+		x[i] = viewProjection[0][0]*p.x + viewProjection[1][0]*p.y + viewProjection[2][0]*p.z + viewProjection[3][0];
+		y[i] = viewProjection[0][1]*p.x + viewProjection[1][1]*p.y + viewProjection[2][1]*p.z + viewProjection[3][1];
+		z[i] = viewProjection[0][2]*p.x + viewProjection[1][2]*p.y + viewProjection[2][2]*p.z + viewProjection[3][2];
+		w[i] = viewProjection[0][3]*p.x + viewProjection[1][3]*p.y + viewProjection[2][3]*p.z + viewProjection[3][3];
+	}
+
+	// which clip planes each corner is outside of, one bit per plane in the order of getClipPlaneDistance
+	std::vector<uint32_t> outcodes(cornerCount);
 
-		// perspective division
-		v /= v.w;
+	for(uint32_t i = 0; i < cornerCount; i++){
+		outcodes[i] = (x[i] < -w[i])
+			| (x[i] > w[i]) << 1
+			| (y[i] < -w[i]) << 2
+			| (y[i] > w[i]) << 3
+			| (z[i] < -w[i]) << 4
+			| (z[i] > w[i]) << 5;
+	}
+
+	bounds.assign(cornerCount / 4, Knee::PortalScreenBounds());
+
+	for(uint32_t i = 0; i < bounds.size(); i++){
+		uint32_t allOutside = outcodes[i*4] & outcodes[i*4 + 1] & outcodes[i*4 + 2] & outcodes[i*4 + 3];
+		uint32_t anyOutside = outcodes[i*4] | outcodes[i*4 + 1] | outcodes[i*4 + 2] | outcodes[i*4 + 3];
+
+		// every corner is on the wrong side of the same plane
+		if(allOutside != 0) continue;
 
-		bool visible = true;
+		glm::vec4 polygon[Knee::VisualPortal::MAX_CLIPPED_VERTICES];
+		uint32_t vertexCount = 4;
 
-		// check that v falls inside range of -1 to 1
 		for(uint32_t j = 0; j < 4; j++){
-			float c = v[j];
+			polygon[j] = glm::vec4(x[i*4 + j], y[i*4 + j], z[i*4 + j], w[i*4 + j]);
+		}
 
-			if(c < -1.0 || c > 1.0){
-				// vertex is visible, no need to continue
-				visible = false;
-				break;
-			}
+		// only clip against the planes that something is actually outside of, which for most portals is none
+		if(anyOutside != 0){
+			vertexCount = Knee::VisualPortal::clipPolygon(polygon, vertexCount, anyOutside);
+		}
+
+		if(vertexCount == 0) continue;
+
+		// perspective division + find extents
+		// everything left is inside the near plane, so w is positive
+		glm::vec3 min = glm::vec3(INFINITY);
+		glm::vec3 max = glm::vec3(-INFINITY);
+
+		for(uint32_t j = 0; j < vertexCount; j++){
+			glm::vec3 ndc = glm::vec3(polygon[j]) / polygon[j].w;
+
+			min = glm::min(min, ndc);
+			max = glm::max(max, ndc);
 		}
 
-		if(visible) return true;
+		Knee::PortalScreenBounds& out = bounds.at(i);
+
+		// clipping leaves us inside the screen already, intersecting just gets rid of rounding error
+		out.rect = Knee::ScreenRect(glm::vec2(min), glm::vec2(max)).intersection(Knee::ScreenRect());
+		out.minDepth = min.z;
+		out.maxDepth = max.z;
+		out.visible = !out.rect.isEmpty();
+	}
+}
 
-		// store for use in other checks
-		ndc[i] = glm::vec3(v);
+float Knee::VisualPortal::getClipPlaneDistance(const glm::vec4& v, uint32_t plane){
+	switch(plane){
+		case 0: return v.w + v.x;
+		case 1: return v.w - v.x;
+		case 2: return v.w + v.y;
+		case 3: return v.w - v.y;
+		case 4: return v.w + v.z;
+		default: return v.w - v.z;
 	}
+}
 
-	glm::vec3 ndcPosition = glm::vec3(0);
-	glm::vec3 ndcSize = glm::vec3(2, 2, 0);
+uint32_t Knee::VisualPortal::clipPolygon(glm::vec4 polygon[], uint32_t vertexCount, uint32_t planes){
+	// sutherland-hodgman, each plane adds at most one vertex
+	glm::vec4 clipped[Knee::VisualPortal::MAX_CLIPPED_VERTICES];
 
-	// check that each of the four sections are satisfied for enveloping
-	bool envelopingCases[] = {false, false, false, false};
+	for(uint32_t plane = 0; plane < 6 && vertexCount > 0; plane++){
+		if((planes & (1 << plane)) == 0) continue;
 
-	// check edges
-	// this also checks for enveloping, when no edges intersect but the entirety of NDC is within the portal's screen area
-	for(uint32_t i = 0; i < 4; i++){
-		glm::vec3 start = ndc[i];
-		glm::vec3 end = ndc[(i+1)%4];
-
-		if(Knee::MathUtils::lineSegmentIntersectingOrWithinAABB(
-			start, end,
-			ndcPosition,
-			ndcSize
-		)){
-			return true;
-		}
+		uint32_t clippedCount = 0;
+
+		for(uint32_t i = 0; i < vertexCount; i++){
+			glm::vec4 start = polygon[i];
+			glm::vec4 end = polygon[(i+1) % vertexCount];
+
+			float startDistance = Knee::VisualPortal::getClipPlaneDistance(start, plane);
+			float endDistance = Knee::VisualPortal::getClipPlaneDistance(end, plane);
+
+			if(startDistance >= 0) clipped[clippedCount++] = start;
+
+			// edge crosses the plane
+			if((startDistance >= 0) != (endDistance >= 0)){
+				float t = startDistance / (startDistance - endDistance);
 
-		// check for enveloping
-		if(start.z > 0.0){
-			if(start.x <= -1.0 && start.y <= -1.0){
-				envelopingCases[0] = true;
-			} else if(start.x >= 1.0 && start.y <= -1.0){
-				envelopingCases[1] = true;
-			} else if(start.x <= -1.0 && start.y >= 1.0){
-				envelopingCases[2] = true;
-			} else if(start.x >= 1.0 && start.y >= 1.0){
-				envelopingCases[3] = true;
+				clipped[clippedCount++] = start + (end - start)*t;
 			}
 		}
-	}
 
-	// check special enveloping case
-	bool enveloping = true;
+		for(uint32_t i = 0; i < clippedCount; i++){
+			polygon[i] = clipped[i];
+		}
 
-	for(uint32_t i = 0; (i < 4) && enveloping; i++){
-		enveloping &= envelopingCases[i];
+		vertexCount = clippedCount;
 	}
 
-	if(enveloping){
-		return true;
-	}
+	return vertexCount;
+}
 
-	// log coordinates
-	if(this->getPosition().z > 0){
-		std::cout << "(" << std::endl;
+void Knee::VisualPortal::getPassObjects(Knee::PortalViewNode* node, std::vector<RenderableObject*>* renderableObjects, Knee::DrawList* drawList, std::vector<RenderableObject*>& passObjects){
+	Knee::PerspectiveCamera* camera = this->getShaderProgram()->getCamera();
 
-		for(uint32_t i = 0; i < 4; i++){
-			std::cout << "\t" << ndc[i].x << ", " << ndc[i].y << "," << ndc[i].z << std::endl;
-		}
+	Knee::GeneralObject cameraTransformation = *camera->asGeneralObject();
 
-		std::cout << ")\n" << std::endl;
+	// look the same way the pass will
+	camera->copyValues(node->cameraTransformation);
+	camera->setCrop(node->bounds);
+	camera->setClipPlane(this->getPassClipPlane(camera));
+	camera->updateViewProjectionMatrix();
+
+	Knee::Frustum frustum = this->getPassFrustum(camera);
+
+	for(uint32_t i = 0; i < renderableObjects->size(); i++){
+		// get object
+		Knee::RenderableObject* obj = renderableObjects->at(i);
+
+		// don't render our pair
+		if(obj == this->m_pair->asRenderableObject()) continue;
+
+		// or anything that's been left out of passes this deep
+		if(!obj->isInPass(node->layerMask, node->depth)) continue;
+
+		// don't render anything that can't be seen through the pair
+		const Knee::DrawItem& item = drawList->getItem(obj);
+
+		if(!frustum.intersectsSphere(item.center, item.radius)) continue;
+
+		passObjects.push_back(obj);
 	}
 
-	return false;
+	// move camera back
+	camera->copyValues(cameraTransformation);
+	camera->resetCrop();
+	camera->resetClipPlane();
+	camera->updateViewProjectionMatrix();
 }
 
-// loads the texture for the visual portal so it can be used for rendering
-void Knee::VisualPortal::loadPortalTexture(std::vector<RenderableObject*>* renderableObjects, Knee::RenderableObjectShaderProgram* renderableObjectShaderProgramWithDepth){
+// renders what can be seen through the portal for a single node of the view tree into a render target from the pool, stored in the node
+// the textures of any portals seen in the pass are expected to have already been set by the tree
+void Knee::VisualPortal::loadPortalTexture(Knee::PortalViewNode* node, const std::vector<RenderableObject*>& passObjects, Knee::DrawList* drawList, Knee::FramebufferPool* framebufferPool, uint32_t screenWidth, uint32_t screenHeight){
 	// FIXME: sometimes there will be a frame of the scene from a weird angle, could be a lot of things but I'm assuming it stems from portals
 
-	// if we have no pair, do nothing
-	if(!this->hasPair()) return;
-
-	// if we're paired to ourselves, do nothing
-	if(this->isOwnPair()) return;
-	
-	// then, check that portal is on screen at all
-	// easy way to do this is transform all four vertices by mvp and check that at least one is within screen coords
-	
 	// get reference to camera
 	// this should be shared across all shader programs, so getting our own is okay
 	Knee::PerspectiveCamera* camera = this->getShaderProgram()->getCamera();
 
-	// check visibility, if not visible from camera then do nothing
-	if(!this->isVisible(camera)){
+	Knee::GeneralObject cameraTransformation = *camera->asGeneralObject();
+
+	// recursion levels start at 0 for portals seen directly by the camera
+	uint32_t recursionLevel = node->depth - 1;
+
+	// size of the area we're actually rendering to
+	glm::vec2 pixelSize = node->bounds.getPixelSize(screenWidth, screenHeight);
+
+	uint32_t passWidth = this->getPassDimension(pixelSize.x, recursionLevel);
+	uint32_t passHeight = this->getPassDimension(pixelSize.y, recursionLevel);
+
+	// only visible portals get here, so render targets are only taken for those
+	Knee::Framebuffer2D* framebuffer = framebufferPool->acquire(
+		this->getRenderTargetDimension(passWidth),
+		this->getRenderTargetDimension(passHeight),
+		this->getRenderTargetFormat(recursionLevel)
+	);
+
+	// bind framebuffer + restrict viewport and scissor to the part we're using
+	// render targets are bigger than what we need so that they can be shared, so only clear + draw the part we use
+	framebuffer->bind();
+	Knee::GLState::setViewport(0, 0, passWidth, passHeight);
+	Knee::GLState::setScissor(0, 0, passWidth, passHeight);
+
+	// clear color + depth buffers		
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+	// move camera + only render our bounds, and clip anything between the camera and the pair
+	camera->copyValues(node->cameraTransformation);
+	camera->setCrop(node->bounds);
+	camera->setClipPlane(this->getPassClipPlane(camera));
+	camera->updateViewProjectionMatrix();
+
+	// deeper levels are rendered at lower resolutions, so objects seen in them can use simpler levels of detail
+	float viewportHeight = camera->getViewportHeight();
+	camera->setViewportHeight(passHeight);
+
+	// render objects, which were already compiled when the pass was culled
+	drawList->draw(passObjects);
+
+	// move camera back
+	camera->setViewportHeight(viewportHeight);
+	camera->copyValues(cameraTransformation);
+	camera->resetCrop();
+	camera->resetClipPlane();
+	camera->updateViewProjectionMatrix();
+
+	// the pass is sampled by whatever node we were seen in
+	node->framebuffer = framebuffer;
+	node->textureScale = glm::vec2((float)passWidth / (float)framebuffer->getWidth(), (float)passHeight / (float)framebuffer->getHeight());
+}
+
+void Knee::VisualPortal::queryOcclusion(){
+	// created on first use so that we don't need a gl context to exist to construct a portal
+	if(this->m_occlusionQuery == 0){
+		glGenQueries(1, &this->m_occlusionQuery);
+	}
+
+	// only test against depth, our surface may already be in the depth buffer in framebuffer mode so equal depth counts as visible
+	Knee::GLState::setColorMask(false);
+	Knee::GLState::setDepthMask(false);
+	Knee::GLState::setDepthFunc(GL_LEQUAL);
+
+	glBeginQuery(GL_ANY_SAMPLES_PASSED, this->m_occlusionQuery);
+
+	RenderableStaticGameObject::draw();
+
+	glEndQuery(GL_ANY_SAMPLES_PASSED);
+
+	Knee::GLState::setDepthFunc(GL_LESS);
+	Knee::GLState::setDepthMask(true);
+	Knee::GLState::setColorMask(true);
+
+	this->m_occlusionQueryIssued = true;
+}
+
+void Knee::VisualPortal::clearOcclusion(){
+	this->m_occlusionQueryIssued = false;
+}
+
+Knee::PortalOcclusion Knee::VisualPortal::getOcclusion(){
+	// nothing to go off of, so assume we can be seen
+	if(!this->m_occlusionQueryIssued) return PORTAL_OCCLUSION_VISIBLE;
+
+	GLuint available = GL_FALSE;
+	glGetQueryObjectuiv(this->m_occlusionQuery, GL_QUERY_RESULT_AVAILABLE, &available);
+
+	if(available == GL_FALSE) return PORTAL_OCCLUSION_PENDING;
+
+	GLuint anySamplesPassed = GL_FALSE;
+	glGetQueryObjectuiv(this->m_occlusionQuery, GL_QUERY_RESULT, &anySamplesPassed);
+
+	return anySamplesPassed == GL_FALSE ? PORTAL_OCCLUSION_HIDDEN : PORTAL_OCCLUSION_VISIBLE;
+}
+
+uint32_t Knee::VisualPortal::getOcclusionQuery(){
+	return this->m_occlusionQuery;
+}
+
+bool Knee::VisualPortal::reprojectsRecursionLevel(uint32_t recursionLevel){
+	return this->m_reprojectDeepLevels && this->m_renderMode == PORTAL_RENDER_MODE_FRAMEBUFFER && recursionLevel >= Knee::VisualPortal::REPROJECTION_RECURSION_LEVEL;
+}
+
+void Knee::VisualPortal::reprojectPortalTexture(Knee::PortalViewNode* node, Knee::FramebufferPool* framebufferPool, uint32_t screenWidth, uint32_t screenHeight){
+	Knee::PerspectiveCamera* camera = this->getShaderProgram()->getCamera();
+
+	Knee::GeneralObject cameraTransformation = *camera->asGeneralObject();
+
+	// where we are on screen in the level that the node's pass is seen through, and in the node's pass itself
+	glm::vec2 outerQuad[4];
+	glm::vec2 innerQuad[4];
+
+	camera->copyValues(node->parent->cameraTransformation);
+	camera->updateViewProjectionMatrix();
+
+	bool outerVisible = this->getScreenQuad(camera->getViewProjectionMatrix(), outerQuad);
+
+	camera->copyValues(node->cameraTransformation);
+	camera->updateViewProjectionMatrix();
+
+	bool innerVisible = this->getScreenQuad(camera->getViewProjectionMatrix(), innerQuad);
+
+	// the next level shows what the node's pass shows, moved from the outer quad onto the inner one
+	glm::mat3 homography;
+
+	if(!outerVisible || !innerVisible || !Knee::MathUtils::computeHomography(innerQuad, outerQuad, homography)){
+		// we stay the fallback color in the pass
+		camera->copyValues(cameraTransformation);
+		camera->updateViewProjectionMatrix();
+
 		return;
 	}
 
-	// calculate camera movement transformation
-	Knee::GeneralObject pairSpaceTransformation = this->getPairSpaceTransformation();
+	// every level shrinks by the same amount, so stop once they're too small to notice
+	float innerArea = Knee::VisualPortal::getQuadPixelArea(innerQuad, screenWidth, screenHeight);
+	float outerArea = Knee::VisualPortal::getQuadPixelArea(outerQuad, screenWidth, screenHeight);
 
-	// calculate inverse
-	Knee::GeneralObject inversePairSpaceTransformation = pairSpaceTransformation.getInverseGeneralObject();
+	uint32_t recursionLevel = node->depth - 1;
+	uint32_t maxLevels = this->m_maxRecursionDepth > recursionLevel ? this->m_maxRecursionDepth - recursionLevel : 0;
+	uint32_t levels = 0;
 
-	// initializes to 1 since we always render at least one side of the portal
-	Knee::GeneralObject totalTransformation;
+	for(float area = innerArea; levels < maxLevels && area >= Knee::VisualPortal::MIN_RECURSION_PIXEL_AREA; area *= innerArea / outerArea){
+		levels++;
+	}
+
+	// from NDC of the node's cropped pass back to the screen, then to where that point was one level up, then into the texture
+	glm::mat3 textureTransform = Knee::VisualPortal::getTextureScaleMatrix(node->textureScale) * node->bounds.getSampleTransform(Knee::ScreenRect()) * homography * node->bounds.getUncropTransform();
+
+	Knee::Framebuffer2D* source = node->framebuffer;
+
+	uint32_t passWidth = (uint32_t)round(node->textureScale.x * source->getWidth());
+	uint32_t passHeight = (uint32_t)round(node->textureScale.y * source->getHeight());
+
+	// draw with the exact same camera as the pass, so that our surface lines up with the depth the pass left behind
+	camera->setCrop(node->bounds);
+	camera->setClipPlane(this->getPassClipPlane(camera));
+	camera->updateViewProjectionMatrix();
+
+	Knee::GLState::setDepthFunc(GL_LEQUAL);
+	Knee::GLState::setDepthMask(false);
 
-	// store transformations in vector
-	// this is mainly so that the portals closest to the camera have the lowest floating point error (least amount of transformations from start)
-	std::vector<Knee::GeneralObject> transformations;
-	transformations.reserve(Knee::VisualPortal::RECURSIVE_WORLD_RENDER_COUNT);
+	for(uint32_t i = 0; i < levels; i++){
+		// render targets of the same size share their depth renderbuffer, so the pass's depth is still there
+		Knee::Framebuffer2D* target = framebufferPool->acquire(source->getWidth(), source->getHeight(), source->getInternalFormat());
 
-	// calculate total transformation from recursive render requests
-	for(uint32_t i = 0; i < Knee::VisualPortal::RECURSIVE_WORLD_RENDER_COUNT+1; i++){
-		totalTransformation *= pairSpaceTransformation;
+		// copy the level, then draw ourselves inside of it using the level as our texture, which adds one more level
+		source->blitColor(target, passWidth, passHeight);
 
-		transformations.push_back(totalTransformation);
+		this->setPortalTexture(source->getTexture2D(), textureTransform);
+		this->draw();
+
+		framebufferPool->release(source);
+		source = target;
 	}
 
-	Knee::GeneralObject cameraTransformation = *camera->asGeneralObject();
+	Knee::GLState::setDepthMask(true);
+	Knee::GLState::setDepthFunc(GL_LESS);
 
-	// apply transformation to camera
-	// this moves it to the model it needs for the last portal in the line, and is then repeatedly moved back until it's at its original position
-	//camera->applyTransformation(totalTransformation);
-	//camera->updateViewProjectionMatrix();
+	this->setPortalTexture(NULL, glm::mat3(1));
+
+	// move camera back
+	camera->copyValues(cameraTransformation);
+	camera->resetCrop();
+	camera->resetClipPlane();
+	camera->updateViewProjectionMatrix();
+
+	node->framebuffer = source;
+}
 
-	// set brightness to precalculated brightness required
-	this->setBrightness(Knee::VisualPortal::RECURSE_PORTAL_BRIGHTNESS);
+bool Knee::VisualPortal::getScreenQuad(glm::mat4 viewProjection, glm::vec2 quad[4]){
+	glm::vec3 vertices[4];
 
-	// active texture info
-	// we need this because we flip between the main and aux texture repeatedly
-	uint32_t activeTexture = 0;
+	this->getVertices(vertices[0], vertices[1], vertices[3], vertices[2]);
 
-	Knee::Framebuffer2D* framebuffers[] = {this->m_mainFramebuffer, this->m_auxFramebuffer};
+	for(uint32_t i = 0; i < 4; i++){
+		glm::vec4 v = viewProjection * glm::vec4(vertices[i], 1);
 
-	// we run this for requested recurses + 1 times to make sure we render at least once
-	for(int32_t i = transformations.size()-1; i >= 0; i--){
-		// get inactive texture
-		uint32_t inactiveTexture = (activeTexture+1) % 2;
+		if(v.w <= 0) return false;
 
-		// bind framebuffer to inactive texture
-		framebuffers[inactiveTexture]->bind();
+		quad[i] = glm::vec2(v) / v.w;
+	}
 
-		// clear color + depth buffers		
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	return true;
+}
 
-		// use active texture
-		this->setTexture(framebuffers[activeTexture]->getTexture2D());
+float Knee::VisualPortal::getQuadPixelArea(const glm::vec2 quad[4], uint32_t screenWidth, uint32_t screenHeight){
+	// shoelace formula
+	float area = 0;
 
-		// move camera
-		camera->applyTransformation(transformations.at(i));
-		camera->updateViewProjectionMatrix();
+	for(uint32_t i = 0; i < 4; i++){
+		glm::vec2 a = quad[i];
+		glm::vec2 b = quad[(i+1)%4];
 
-		// render objects
-		for(uint32_t j = 0; j < renderableObjects->size(); j++){
-			// get object
-			Knee::RenderableObject* obj = renderableObjects->at(j);
+		area += a.x * b.y - b.x * a.y;
+	}
 
-			// don't render our pair
-			if(obj == this->m_pair->asRenderableObject()) continue;
+	// NDC spans 2 units across the screen
+	return std::abs(area) / 2.f * (screenWidth / 2.f) * (screenHeight / 2.f);
+}
 
-			// don't render ourselves on first pass only (active texture won't be populated)
-			if(i == Knee::VisualPortal::RECURSIVE_WORLD_RENDER_COUNT && obj == this->asRenderableObject()) continue; 
+glm::mat3 Knee::VisualPortal::getTextureScaleMatrix(glm::vec2 scale){
+	glm::mat3 out = glm::mat3(1);
 
-			// draw object
-			obj->draw();
-		}
+	out[0][0] = scale.x;
+	out[1][1] = scale.y;
 
-		// move camera back
-		camera->copyValues(cameraTransformation);
+	return out;
+}
+
+Knee::Frustum Knee::VisualPortal::getPassFrustum(Knee::Camera* camera){
+	// start with everything the camera can see
+	Knee::Frustum frustum(camera->getViewProjectionMatrix());
+
+	glm::vec3 eye = camera->getPosition();
+
+	// narrow to the pair's opening
+	glm::vec3 quad[4];
+
+	this->m_pair->getVertices(quad[0], quad[1], quad[3], quad[2]);
+
+	frustum.addQuadPlanes(eye, quad);
+
+	// only keep what's on the far side of the pair
+	// the camera's near plane is usually this plane already, but not if the camera is too close to the pair for it to be used
+	glm::vec4 plane = this->getPassClipPlane(camera);
+
+	frustum.addPlane(this->m_pair->getPosition(), glm::vec3(plane));
+
+	return frustum;
+}
+
+glm::vec4 Knee::VisualPortal::getPassClipPlane(Knee::Camera* camera){
+	glm::vec3 normal = this->m_pair->getLocalZAxis();
+
+	if(glm::dot(normal, camera->getPosition() - this->m_pair->getPosition()) > 0) normal = -normal;
+
+	normal = glm::normalize(normal);
+
+	// pull the plane back slightly towards the camera
+	return glm::vec4(normal, -glm::dot(normal, this->m_pair->getPosition()) + Knee::VisualPortal::CLIP_PLANE_OFFSET);
+}
+
+uint32_t Knee::VisualPortal::getPassDimension(float pixels, uint32_t recursionLevel){
+	// shrink for each recursion level
+	pixels *= (float)pow(Knee::VisualPortal::RECURSE_RESOLUTION_FALLOFF, (double)recursionLevel);
+
+	return std::max((uint32_t)ceil(pixels), (uint32_t)1);
+}
+
+uint32_t Knee::VisualPortal::getRenderTargetDimension(uint32_t passDimension){
+	// round up to a multiple of the step so that passes with similar bounds can share render targets
+	uint32_t step = Knee::VisualPortal::RENDER_TARGET_SIZE_STEP;
+	uint32_t out = (passDimension + step - 1) / step * step;
+
+	if(out < Knee::VisualPortal::MIN_RENDER_TARGET_SIZE){
+		out = Knee::VisualPortal::MIN_RENDER_TARGET_SIZE;
+	}
+
+	return out;
+}
+
+GLenum Knee::VisualPortal::getRenderTargetFormat(uint32_t recursionLevel){
+	if(this->m_useLowPrecisionDeepLevels && recursionLevel >= Knee::VisualPortal::LOW_PRECISION_RECURSION_LEVEL){
+		// NOTE: GL_RGB565 isn't part of the 3.3 core profile, but drivers generally store GL_RGB5 as 565
+		return GL_RGB5;
+	}
+
+	return GL_RGB8;
+}
+
+void Knee::VisualPortal::setLowPrecisionDeepLevels(bool useLowPrecision){
+	this->m_useLowPrecisionDeepLevels = useLowPrecision;
+}
+
+void Knee::VisualPortal::setReprojectDeepLevels(bool reproject){
+	this->m_reprojectDeepLevels = reproject;
+}
+
+uint32_t Knee::VisualPortal::getMaxRecursionDepth(){
+	return this->m_maxRecursionDepth;
+}
+
+void Knee::VisualPortal::setMaxRecursionDepth(uint32_t maxRecursionDepth){
+	this->m_maxRecursionDepth = maxRecursionDepth;
+}
+
+void Knee::VisualPortal::markStencil(uint32_t recursionLevel){
+	// only touch the stencil buffer
+	Knee::GLState::setColorMask(false);
+	Knee::GLState::setDepthMask(false);
+
+	// increment wherever the portal passes the depth test inside the current level
+	Knee::GLState::setStencilFunc(GL_EQUAL, recursionLevel, 0xFF);
+	Knee::GLState::setStencilOp(GL_KEEP, GL_KEEP, GL_INCR);
+
+	RenderableStaticGameObject::draw();
+
+	Knee::GLState::setColorMask(true);
+	Knee::GLState::setDepthMask(true);
+}
+
+void Knee::VisualPortal::clearStencilRegion(uint32_t recursionLevel){
+	// glClear ignores the stencil test, so we clear by drawing the portal surface at the far plane with the fill color instead
+	GLfloat clearColor[4];
+	glGetFloatv(GL_COLOR_CLEAR_VALUE, clearColor);
+
+	Knee::GLState::setStencilFunc(GL_EQUAL, recursionLevel+1, 0xFF);
+	Knee::GLState::setStencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
+
+	Knee::GLState::setDepthFunc(GL_ALWAYS);
+	Knee::GLState::setDepthRange(1.0, 1.0);
+
+	this->setFillColor(true, glm::vec4(clearColor[0], clearColor[1], clearColor[2], clearColor[3]));
+
+	RenderableStaticGameObject::draw();
+
+	this->setFillColor(false);
+
+	Knee::GLState::setDepthRange(0.0, 1.0);
+	Knee::GLState::setDepthFunc(GL_LESS);
+}
+
+void Knee::VisualPortal::unmarkStencil(uint32_t recursionLevel){
+	Knee::GLState::setColorMask(false);
+
+	// overwrite the depth of whatever was seen through the portal with the depth of the portal itself, so that anything rendered afterwards is occluded by the portal properly
+	Knee::GLState::setDepthFunc(GL_ALWAYS);
+
+	Knee::GLState::setStencilFunc(GL_EQUAL, recursionLevel+1, 0xFF);
+	Knee::GLState::setStencilOp(GL_KEEP, GL_KEEP, GL_DECR);
+
+	RenderableStaticGameObject::draw();
+
+	Knee::GLState::setColorMask(true);
+	Knee::GLState::setDepthFunc(GL_LESS);
 
-		// flip active texture
-		activeTexture = inactiveTexture;
+	// return to the previous level
+	Knee::GLState::setStencilFunc(GL_EQUAL, recursionLevel, 0xFF);
+	Knee::GLState::setStencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
+}
+
+void Knee::VisualPortal::renderPortalStencil(Knee::PortalViewNode* node, std::vector<Knee::VisualPortal*>* portals, std::vector<RenderableObject*>* renderableObjects, Knee::DrawList* drawList, uint32_t screenWidth, uint32_t screenHeight){
+	// get reference to camera
+	// this should be shared across all shader programs, so getting our own is okay
+	Knee::PerspectiveCamera* camera = this->getShaderProgram()->getCamera();
+
+	// recursion levels start at 0 for portals seen directly by the camera, which is also the stencil value of the level we're seen in
+	uint32_t recursionLevel = node->depth - 1;
+
+	// restrict everything in this level to our bounds
+	Knee::VisualPortal::setScissor(node->bounds, screenWidth, screenHeight);
+
+	// mark where we can be seen, then clear that area so the view through us can be drawn into it
+	this->markStencil(recursionLevel);
+	this->clearStencilRegion(recursionLevel);
+
+	// move camera to view through the pair, clipping anything between the camera and the pair
+	// the level we're drawn in may have its own clip plane, so keep it to restore later
+	Knee::GeneralObject cameraTransformation = *camera->asGeneralObject();
+	bool hadClipPlane = camera->hasClipPlane();
+	glm::vec4 previousClipPlane = camera->getClipPlane();
+
+	// only what's in the cell we're looking into, culled the same way as in framebuffer mode
+	// this leaves the camera without a clip plane, which is why the previous one was kept first
+	std::vector<RenderableObject*> passObjects;
+
+	this->getPassObjects(node, Knee::PortalViewTree::getNodeObjects(node, renderableObjects), drawList, passObjects);
+
+	camera->copyValues(node->cameraTransformation);
+	camera->setClipPlane(this->getPassClipPlane(camera));
+	camera->updateViewProjectionMatrix();
+
+	// only draw inside our region
+	Knee::GLState::setStencilFunc(GL_EQUAL, recursionLevel+1, 0xFF);
+
+	// render objects
+	// portals with a node of their own draw nothing here, the rest are filled with their fallback color
+	Knee::PortalViewTree::setStencilNodes(node, portals);
+
+	drawList->draw(passObjects);
+
+	// draw the portals that can be seen from here, most visible first
+	for(uint32_t i = 0; i < node->children.size(); i++){
+		Knee::PortalViewNode* child = node->children.at(i);
+
+		child->portal->renderPortalStencil(child, portals, renderableObjects, drawList, screenWidth, screenHeight);
+
+		// deeper level will have shrunk the scissor
+		Knee::VisualPortal::setScissor(node->bounds, screenWidth, screenHeight);
 	}
 
+	// move camera back
 	camera->copyValues(cameraTransformation);
+
+	if(hadClipPlane){
+		camera->setClipPlane(previousClipPlane);
+	} else {
+		camera->resetClipPlane();
+	}
+
 	camera->updateViewProjectionMatrix();
 
-	// reset brightness
-	this->setBrightness(1.0);
+	// restore our surface's depth and the stencil level
+	this->unmarkStencil(recursionLevel);
+}
 
-	// reset to default framebuffer
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+void Knee::VisualPortal::setScissor(const Knee::ScreenRect& bounds, uint32_t screenWidth, uint32_t screenHeight){
+	// bounds are expected to already be snapped to pixels
+	glm::vec2 min = (bounds.getMin()*0.5f + 0.5f) * glm::vec2(screenWidth, screenHeight);
+	glm::vec2 size = bounds.getPixelSize(screenWidth, screenHeight);
 
-	// set our texture to whichever was rendered to last
-	// activeTexture because inactiveTexture is rendered to before being flipped to the activeTexture at the end of the for loop
-	this->setTexture(framebuffers[activeTexture]->getTexture2D());
+	Knee::GLState::setScissor((GLint)round(min.x), (GLint)round(min.y), (GLsizei)round(size.x), (GLsizei)round(size.y));
+}
+
+float Knee::VisualPortal::getRecursePortalBrightness(){
+	return (float)pow(Knee::VisualPortal::LAST_RECURSE_BRIGHTNESS, 1.0 / (double)(this->m_maxRecursionDepth+1));
+}
+
+bool Knee::VisualPortal::isRecursionVisible(const Knee::ScreenRect& bounds, uint32_t screenWidth, uint32_t screenHeight){
+	glm::vec2 size = bounds.getPixelSize(screenWidth, screenHeight);
+
+	return size.x * size.y >= Knee::VisualPortal::MIN_RECURSION_PIXEL_AREA;
+}
+
+Knee::PortalRenderMode Knee::VisualPortal::getRenderMode(){
+	return this->m_renderMode;
+}
+
+void Knee::VisualPortal::setRenderMode(Knee::PortalRenderMode renderMode){
+	this->m_renderMode = renderMode;
+}
+
+bool Knee::VisualPortal::hasCustomDraw(){
+	return true;
 }
 
 void Knee::VisualPortal::draw(){
 	// draw nothing if we're our own pair
 	if(this->isOwnPair()) return;
 
+	// in stencil mode, our contents are drawn by renderPortalStencil rather than sampled from a texture
+	if(this->m_renderMode == PORTAL_RENDER_MODE_STENCIL && this->m_hasStencilNode) return;
+
+	// nothing was rendered for us, so just draw a flat color
+	if(this->m_renderMode == PORTAL_RENDER_MODE_STENCIL || !this->hasTexture()){
+		this->setFillColor(true, this->m_fallbackColor);
+
+		RenderableStaticGameObject::draw();
+
+		this->setFillColor(false);
+
+		return;
+	}
+
+	// sample the part of the texture that lines up with our position on screen
+	this->getShaderProgram()->setUniform(this->getUniforms().textureTransform, this->m_textureTransform);
+
 	// draw
 	RenderableStaticGameObject::draw();
 }
@@ -284,20 +732,62 @@ bool Knee::VisualPortal::hasPair(){
 	return this->m_pair != NULL;
 }
 
+Knee::Cell* Knee::VisualPortal::getCell(){
+	return this->m_cell;
+}
+
+void Knee::VisualPortal::setCell(Knee::Cell* cell){
+	this->m_cell = cell;
+}
+
 bool Knee::VisualPortal::isOwnPair(){
 	return this->m_pair == this;
 }
 
+const Knee::VisualPortal::PortalUniforms& Knee::VisualPortal::getUniforms(){
+	Knee::RenderableObjectShaderProgram* program = this->getShaderProgram();
+
+	// handles can't be looked up until the program is compiled
+	if(this->m_uniforms.program != program && program->isCompiled()){
+		this->m_uniforms.program = program;
+
+		this->m_uniforms.textureTransform = program->getUniform<glm::mat3>("u_textureTransform");
+		this->m_uniforms.brightness = program->getUniform<float>("u_brightness");
+		this->m_uniforms.useFillColor = program->getUniform<bool>("u_useFillColor");
+		this->m_uniforms.fillColor = program->getUniform<glm::vec4>("u_fillColor");
+	}
+
+	return this->m_uniforms;
+}
+
 void Knee::VisualPortal::setBrightness(float brightness){
-	this->getShaderProgram()->use();
+	this->getShaderProgram()->setUniform(this->getUniforms().brightness, brightness);
+}
+
+void Knee::VisualPortal::setPortalTexture(Knee::Texture2D* texture, glm::mat3 textureTransform){
+	this->setTexture(texture);
+	this->m_textureTransform = textureTransform;
+}
+
+void Knee::VisualPortal::setHasStencilNode(bool hasStencilNode){
+	this->m_hasStencilNode = hasStencilNode;
+}
 
-	glUniform1f(this->getShaderProgram()->getUniformLocation("u_brightness"), brightness);
+void Knee::VisualPortal::setFallbackColor(glm::vec4 color){
+	this->m_fallbackColor = color;
+}
+
+void Knee::VisualPortal::setFillColor(bool useFillColor, glm::vec4 color){
+	const Knee::VisualPortal::PortalUniforms& uniforms = this->getUniforms();
+
+	this->getShaderProgram()->setUniform(uniforms.useFillColor, useFillColor);
+	this->getShaderProgram()->setUniform(uniforms.fillColor, color);
 }
 
 // -------------------- //
 // Portal //
 
-Knee::Portal::Portal(Knee::VertexData* vertexData, uint32_t screenWidth, uint32_t screenHeight) : VisualPortal(vertexData, screenWidth, screenHeight) {}
+Knee::Portal::Portal(Knee::VertexData* vertexData) : VisualPortal(vertexData) {}
 
 Knee::VisualPortal* Knee::Portal::asVisualPortal(){
 	return static_cast<Knee::VisualPortal*>(this);
@@ -347,4 +837,487 @@ bool Knee::Portal::checkPlayer(Knee::Player* player, double delta){
 
 	// return true (player was moved)
 	return true;
-}
\ No newline at end of file
+}
+
+// -------------------- //
+// PortalTextureCache //
+
+void Knee::PortalTextureCache::beginFrame(){
+	this->m_frame++;
+}
+
+bool Knee::PortalTextureCache::fetch(Knee::PortalViewNode* node, const std::vector<RenderableObject*>& passObjects, Knee::FramebufferPool* framebufferPool, uint32_t screenWidth, uint32_t screenHeight){
+	std::map<std::vector<Knee::VisualPortal*>, CachedTexture>::iterator it = this->m_textures.find(Knee::PortalTextureCache::getPath(node));
+
+	if(it == this->m_textures.end()) return false;
+
+	CachedTexture& cached = it->second;
+
+	// the view has to be looking from exactly the same place, at exactly the same part of the screen
+	bool valid = cached.cameraTransformation.getPosition() == node->cameraTransformation.getPosition()
+		&& cached.cameraTransformation.getRotation() == node->cameraTransformation.getRotation()
+		&& cached.cameraTransformation.getScale() == node->cameraTransformation.getScale()
+		&& cached.bounds.getMin() == node->bounds.getMin()
+		&& cached.bounds.getMax() == node->bounds.getMax()
+		&& cached.reprojectSelf == node->reprojectSelf
+		&& cached.passObjects == passObjects;
+
+	// at the same resolution, with the same projection, since a resize or fov change can leave the bounds as they were
+	valid = valid && cached.screenWidth == screenWidth
+		&& cached.screenHeight == screenHeight
+		&& cached.projectionMatrix == node->portal->getShaderProgram()->getCamera()->getProjectionMatrix();
+
+	// the portals seen in it have to be the same, and not have been rendered again themselves
+	valid = valid && cached.childPortals.size() == node->children.size();
+
+	for(uint32_t i = 0; valid && i < node->children.size(); i++){
+		Knee::PortalViewNode* child = node->children.at(i);
+
+		valid = cached.childPortals.at(i) == child->portal && !child->changed;
+	}
+
+	// and nothing seen in it can have moved
+	for(uint32_t i = 0; valid && i < passObjects.size(); i++){
+		valid = passObjects.at(i)->getTransformVersion() <= cached.transformVersion;
+	}
+
+	if(!valid){
+		// won't be useful again, so give the render target back right away so that the new pass can use it
+		this->remove(it, framebufferPool);
+
+		return false;
+	}
+
+	cached.lastUsedFrame = this->m_frame;
+
+	node->framebuffer = cached.framebuffer;
+	node->textureScale = cached.textureScale;
+	node->changed = false;
+	node->cached = true;
+
+	return true;
+}
+
+void Knee::PortalTextureCache::store(Knee::PortalViewNode* node, const std::vector<RenderableObject*>& passObjects, Knee::FramebufferPool* framebufferPool, uint32_t screenWidth, uint32_t screenHeight){
+	// the gpu may have skipped drawing it
+	if(node->conditional) return;
+
+	size_t bytes = Knee::PortalTextureCache::getFramebufferBytes(node->framebuffer);
+
+	// if it doesn't fit, the node's render target is just released once it's been sampled like normal
+	if(!this->makeRoom(bytes, framebufferPool)) return;
+
+	CachedTexture cached;
+	cached.framebuffer = node->framebuffer;
+	cached.textureScale = node->textureScale;
+	cached.cameraTransformation = node->cameraTransformation;
+	cached.projectionMatrix = node->portal->getShaderProgram()->getCamera()->getProjectionMatrix();
+	cached.screenWidth = screenWidth;
+	cached.screenHeight = screenHeight;
+	cached.bounds = node->bounds;
+	cached.reprojectSelf = node->reprojectSelf;
+	cached.passObjects = passObjects;
+	cached.transformVersion = Knee::GeneralObject::getLatestTransformVersion();
+	cached.lastUsedFrame = this->m_frame;
+	cached.bytes = bytes;
+
+	for(uint32_t i = 0; i < node->children.size(); i++){
+		cached.childPortals.push_back(node->children.at(i)->portal);
+	}
+
+	// fetch already removed anything that was here before
+	this->m_textures[Knee::PortalTextureCache::getPath(node)] = cached;
+	this->m_bytes += bytes;
+
+	framebufferPool->retain(node->framebuffer);
+	node->cached = true;
+}
+
+void Knee::PortalTextureCache::clear(Knee::FramebufferPool* framebufferPool){
+	while(!this->m_textures.empty()){
+		this->remove(this->m_textures.begin(), framebufferPool);
+	}
+}
+
+bool Knee::PortalTextureCache::makeRoom(size_t bytes, Knee::FramebufferPool* framebufferPool){
+	while(this->m_bytes + bytes > this->m_maxBytes){
+		// find the least recently used texture, ignoring any used this frame since they might still be sampled
+		std::map<std::vector<Knee::VisualPortal*>, CachedTexture>::iterator oldest = this->m_textures.end();
+
+		for(std::map<std::vector<Knee::VisualPortal*>, CachedTexture>::iterator it = this->m_textures.begin(); it != this->m_textures.end(); ++it){
+			if(it->second.lastUsedFrame == this->m_frame) continue;
+
+			if(oldest == this->m_textures.end() || it->second.lastUsedFrame < oldest->second.lastUsedFrame){
+				oldest = it;
+			}
+		}
+
+		if(oldest == this->m_textures.end()) return false;
+
+		this->remove(oldest, framebufferPool);
+	}
+
+	return true;
+}
+
+void Knee::PortalTextureCache::remove(std::map<std::vector<Knee::VisualPortal*>, CachedTexture>::iterator it, Knee::FramebufferPool* framebufferPool){
+	framebufferPool->release(it->second.framebuffer);
+
+	this->m_bytes -= it->second.bytes;
+	this->m_textures.erase(it);
+}
+
+std::vector<Knee::VisualPortal*> Knee::PortalTextureCache::getPath(Knee::PortalViewNode* node){
+	std::vector<Knee::VisualPortal*> path;
+
+	for(; node->portal != NULL; node = node->parent){
+		path.push_back(node->portal);
+	}
+
+	std::reverse(path.begin(), path.end());
+
+	return path;
+}
+
+size_t Knee::PortalTextureCache::getFramebufferBytes(Knee::Framebuffer2D* framebuffer){
+	// drivers generally pad 24 bit formats out to 32 bits
+	size_t bytesPerPixel = framebuffer->getInternalFormat() == GL_RGB5 ? 2 : 4;
+
+	return (size_t)framebuffer->getWidth() * (size_t)framebuffer->getHeight() * bytesPerPixel;
+}
+
+size_t Knee::PortalTextureCache::getMaxBytes(){
+	return this->m_maxBytes;
+}
+
+void Knee::PortalTextureCache::setMaxBytes(size_t maxBytes){
+	this->m_maxBytes = maxBytes;
+}
+
+size_t Knee::PortalTextureCache::getByteCount(){
+	return this->m_bytes;
+}
+
+// -------------------- //
+// PortalViewTree //
+
+void Knee::PortalViewTree::build(Knee::Camera* camera, Knee::Cell* cell, uint32_t layerMask, std::vector<Knee::VisualPortal*>* portals, uint32_t screenWidth, uint32_t screenHeight){
+	this->m_nodes.clear();
+	this->m_passCount = 0;
+
+	Knee::VisualPortal::getCorners(*portals, this->m_portalCorners);
+
+	// the root sees the whole screen from wherever the camera is
+	this->m_nodes.push_back(Knee::PortalViewNode());
+	this->m_root = &this->m_nodes.back();
+	this->m_root->cameraTransformation = *camera->asGeneralObject();
+	this->m_root->cell = cell;
+	this->m_root->layerMask = layerMask;
+
+	// heap of nodes that could be rendered, biggest on screen first
+	std::vector<Knee::PortalViewNode*> candidates;
+
+	this->addCandidates(this->m_root, camera, portals, candidates, screenWidth, screenHeight);
+
+	while(!candidates.empty() && this->m_passCount < this->m_passBudget){
+		std::pop_heap(candidates.begin(), candidates.end(), Knee::PortalViewTree::compareCoverage);
+
+		Knee::PortalViewNode* node = candidates.back();
+		candidates.pop_back();
+
+		// accept the node, which means whatever can be seen in its pass is now a candidate too
+		node->parent->children.push_back(node);
+		this->m_passCount++;
+
+		this->addCandidates(node, camera, portals, candidates, screenWidth, screenHeight);
+	}
+
+	// whatever's left over is never attached, so it ends up with its fallback color
+
+	// move camera back
+	camera->copyValues(this->m_root->cameraTransformation);
+	camera->updateViewProjectionMatrix();
+}
+
+void Knee::PortalViewTree::addCandidates(Knee::PortalViewNode* parent, Knee::Camera* camera, std::vector<Knee::VisualPortal*>* portals, std::vector<Knee::PortalViewNode*>& candidates, uint32_t screenWidth, uint32_t screenHeight){
+	// look from the parent's point of view
+	camera->copyValues(parent->cameraTransformation);
+	camera->updateViewProjectionMatrix();
+
+	// find every portal on screen at once
+	Knee::VisualPortal::getScreenBounds(camera->getViewProjectionMatrix(), this->m_portalCorners, this->m_portalScreenBounds);
+
+	// what the parent's pass can see, which is everything for the root
+	Knee::Frustum frustum;
+
+	if(parent->portal != NULL){
+		frustum = parent->portal->getPassFrustum(camera);
+	}
+
+	for(uint32_t i = 0; i < portals->size(); i++){
+		Knee::VisualPortal* portal = portals->at(i);
+
+		// if we have no pair or are paired to ourselves, there's nothing to see through us
+		if(!portal->hasPair() || portal->isOwnPair()) continue;
+
+		// the pair of the parent's portal isn't drawn in its pass
+		if(parent->portal != NULL && portal == parent->portal->getPair()) continue;
+
+		// portals in other cells can't be seen from the parent's
+		if(parent->cell != NULL && portal->getCell() != NULL && portal->getCell() != parent->cell) continue;
+
+		// the portal isn't drawn in the parent's pass
+		if(!portal->isInPass(parent->layerMask, parent->depth)) continue;
+
+		// deeper nodes would wrap around the stencil buffer, no matter the pass budget or recursion limit
+		if(portal->getRenderMode() == PORTAL_RENDER_MODE_STENCIL && parent->depth >= Knee::PortalViewTree::MAX_STENCIL_DEPTH) continue;
+
+		// the recursion limit only applies to a portal seen through itself, other chains are left to the pass budget
+		if(parent->depth > portal->getMaxRecursionDepth()){
+			bool recursive = false;
+
+			for(Knee::PortalViewNode* ancestor = parent; ancestor != NULL; ancestor = ancestor->parent){
+				if(ancestor->portal == portal){
+					recursive = true;
+					break;
+				}
+			}
+
+			if(recursive) continue;
+		}
+
+		// the occlusion query is only against the main view, so it says nothing about what can be seen through other portals
+		Knee::PortalOcclusion occlusion = PORTAL_OCCLUSION_VISIBLE;
+
+		if(parent == this->m_root){
+			occlusion = portal->getOcclusion();
+
+			// completely hidden last frame
+			if(occlusion == PORTAL_OCCLUSION_HIDDEN) continue;
+		}
+
+		// has to be on the far side of the parent's pair
+		glm::vec3 center;
+		float radius;
+
+		portal->getBoundingSphere(center, radius);
+
+		if(!frustum.intersectsSphere(center, radius)) continue;
+
+		// find the part of the screen we cover, which can only be seen through the parent's part
+		const Knee::PortalScreenBounds& screenBounds = this->m_portalScreenBounds.at(i);
+
+		if(!screenBounds.visible) continue;
+
+		Knee::ScreenRect bounds = screenBounds.rect.intersection(parent->bounds).snappedToPixels(screenWidth, screenHeight);
+
+		if(bounds.isEmpty()) continue;
+
+		// portals seen directly by the camera are always rendered, but deeper ones can be dropped once they're too small to notice
+		if(parent->depth > 0 && !Knee::VisualPortal::isRecursionVisible(bounds, screenWidth, screenHeight)) continue;
+
+		// deep enough views of a portal through itself are warped from the parent's pass instead of getting their own
+		if(portal == parent->portal && portal->reprojectsRecursionLevel(parent->depth)){
+			parent->reprojectSelf = true;
+			continue;
+		}
+
+		this->m_nodes.push_back(Knee::PortalViewNode());
+
+		Knee::PortalViewNode* node = &this->m_nodes.back();
+
+		node->portal = portal;
+		node->parent = parent;
+		node->depth = parent->depth + 1;
+		node->bounds = bounds;
+		node->layerMask = this->m_layerMask;
+		node->minDepth = screenBounds.minDepth;
+		node->maxDepth = screenBounds.maxDepth;
+		node->conditional = parent->conditional || occlusion == PORTAL_OCCLUSION_PENDING;
+
+		// cells are only followed once we know which one the camera is in
+		if(parent->cell != NULL) node->cell = portal->getPair()->getCell();
+
+		// the view through the portal is the parent's view moved into pair space
+		camera->applyTransformation(portal->getPairSpaceTransformation());
+		node->cameraTransformation = *camera->asGeneralObject();
+		camera->copyValues(parent->cameraTransformation);
+
+		candidates.push_back(node);
+		std::push_heap(candidates.begin(), candidates.end(), Knee::PortalViewTree::compareCoverage);
+	}
+}
+
+bool Knee::PortalViewTree::compareCoverage(Knee::PortalViewNode* a, Knee::PortalViewNode* b){
+	glm::vec2 sizeA = a->bounds.getSize();
+	glm::vec2 sizeB = b->bounds.getSize();
+
+	float areaA = sizeA.x * sizeA.y;
+	float areaB = sizeB.x * sizeB.y;
+
+	// closest first if they cover the same area
+	if(areaA == areaB) return a->minDepth > b->minDepth;
+
+	return areaA < areaB;
+}
+
+void Knee::PortalViewTree::loadPortalTextures(std::vector<Knee::VisualPortal*>* portals, std::vector<RenderableObject*>* renderableObjects, Knee::DrawList* drawList, Knee::FramebufferPool* framebufferPool, uint32_t screenWidth, uint32_t screenHeight){
+	this->m_textureCache.beginFrame();
+
+	// passes only clear + draw the part of their render target they use
+	Knee::GLState::enable(GL_SCISSOR_TEST);
+
+	for(uint32_t i = 0; i < this->m_root->children.size(); i++){
+		Knee::PortalViewNode* child = this->m_root->children.at(i);
+
+		// the query hasn't come back yet, so let the gpu skip the passes if it turns out that we're hidden
+		if(child->conditional) glBeginConditionalRender(child->portal->getOcclusionQuery(), GL_QUERY_NO_WAIT);
+
+		this->loadNodeTexture(child, portals, renderableObjects, drawList, framebufferPool, screenWidth, screenHeight);
+
+		if(child->conditional) glEndConditionalRender();
+	}
+
+	Knee::GLState::disable(GL_SCISSOR_TEST);
+
+	// reset to default framebuffer + viewport
+	Knee::GLState::bindFramebuffer(GL_FRAMEBUFFER, 0);
+	Knee::GLState::setViewport(0, 0, screenWidth, screenHeight);
+
+	// the root's render targets stay in use until the pool's frame ends
+	this->setPortalTextures(this->m_root, portals);
+}
+
+void Knee::PortalViewTree::loadNodeTexture(Knee::PortalViewNode* node, std::vector<Knee::VisualPortal*>* portals, std::vector<RenderableObject*>* renderableObjects, Knee::DrawList* drawList, Knee::FramebufferPool* framebufferPool, uint32_t screenWidth, uint32_t screenHeight){
+	// render deepest passes first, since they're sampled by this one
+	for(uint32_t i = 0; i < node->children.size(); i++){
+		this->loadNodeTexture(node->children.at(i), portals, renderableObjects, drawList, framebufferPool, screenWidth, screenHeight);
+	}
+
+	std::vector<RenderableObject*> passObjects;
+	node->portal->getPassObjects(node, Knee::PortalViewTree::getNodeObjects(node, renderableObjects), drawList, passObjects);
+
+	// nothing we can see has changed since we were last rendered, so keep what we had
+	if(this->m_textureCache.fetch(node, passObjects, framebufferPool, screenWidth, screenHeight)) return;
+
+	this->setPortalTextures(node, portals);
+
+	node->portal->loadPortalTexture(node, passObjects, drawList, framebufferPool, screenWidth, screenHeight);
+
+	if(node->reprojectSelf){
+		node->portal->reprojectPortalTexture(node, framebufferPool, screenWidth, screenHeight);
+	}
+
+	// children have been sampled, so their render targets can go back to the pool for other passes to use
+	// cached ones are kept for later frames
+	for(uint32_t i = 0; i < node->children.size(); i++){
+		Knee::PortalViewNode* child = node->children.at(i);
+
+		if(!child->cached) framebufferPool->release(child->framebuffer);
+		child->framebuffer = NULL;
+	}
+
+	this->m_textureCache.store(node, passObjects, framebufferPool, screenWidth, screenHeight);
+}
+
+void Knee::PortalViewTree::setPortalTextures(Knee::PortalViewNode* node, std::vector<Knee::VisualPortal*>* portals){
+	if(portals->empty()) return;
+
+	// anything that doesn't have a node of its own here is drawn with its fallback color
+	for(uint32_t i = 0; i < portals->size(); i++){
+		portals->at(i)->setPortalTexture(NULL, glm::mat3(1));
+	}
+
+	// sample the part of the child's pass that lines up with where it's drawn in ours
+	for(uint32_t i = 0; i < node->children.size(); i++){
+		Knee::PortalViewNode* child = node->children.at(i);
+
+		child->portal->setPortalTexture(
+			child->framebuffer->getTexture2D(),
+			Knee::VisualPortal::getTextureScaleMatrix(child->textureScale) * child->bounds.getSampleTransform(node->bounds)
+		);
+	}
+
+	// brightness is shared by all portals, so it's set for the whole pass
+	if(node->portal != NULL){
+		node->portal->setBrightness(node->portal->getRecursePortalBrightness());
+	} else {
+		portals->at(0)->setBrightness(1.0);
+	}
+}
+
+void Knee::PortalViewTree::renderPortalsStencil(std::vector<Knee::VisualPortal*>* portals, std::vector<RenderableObject*>* renderableObjects, Knee::DrawList* drawList, uint32_t screenWidth, uint32_t screenHeight){
+	// nothing draws over the portals in the main view that didn't get a node, so fill them before anything is drawn through the ones that did
+	Knee::PortalViewTree::setStencilNodes(this->m_root, portals);
+	Knee::GLState::setScissor(0, 0, screenWidth, screenHeight);
+
+	for(uint32_t i = 0; i < portals->size(); i++){
+		Knee::VisualPortal* portal = portals->at(i);
+
+		// same as what the main view could see
+		if(this->m_root->cell != NULL && portal->getCell() != NULL && portal->getCell() != this->m_root->cell) continue;
+		if(!portal->isInPass(this->m_root->layerMask, this->m_root->depth)) continue;
+
+		portal->draw();
+	}
+
+	// children render their own children
+	for(uint32_t i = 0; i < this->m_root->children.size(); i++){
+		Knee::PortalViewNode* child = this->m_root->children.at(i);
+
+		if(child->conditional) glBeginConditionalRender(child->portal->getOcclusionQuery(), GL_QUERY_NO_WAIT);
+
+		child->portal->renderPortalStencil(child, portals, renderableObjects, drawList, screenWidth, screenHeight);
+
+		if(child->conditional) glEndConditionalRender();
+	}
+
+	// draw nothing again until the next tree is rendered
+	for(uint32_t i = 0; i < portals->size(); i++){
+		portals->at(i)->setHasStencilNode(true);
+	}
+}
+
+void Knee::PortalViewTree::setStencilNodes(Knee::PortalViewNode* node, std::vector<Knee::VisualPortal*>* portals){
+	for(uint32_t i = 0; i < portals->size(); i++){
+		portals->at(i)->setHasStencilNode(false);
+	}
+
+	for(uint32_t i = 0; i < node->children.size(); i++){
+		node->children.at(i)->portal->setHasStencilNode(true);
+	}
+}
+
+std::vector<Knee::RenderableObject*>* Knee::PortalViewTree::getNodeObjects(Knee::PortalViewNode* node, std::vector<RenderableObject*>* renderableObjects){
+	if(node->cell == NULL) return renderableObjects;
+
+	return node->cell->getDrawnObjects();
+}
+
+Knee::PortalViewNode* Knee::PortalViewTree::getRoot(){
+	return this->m_root;
+}
+
+Knee::PortalTextureCache* Knee::PortalViewTree::getTextureCache(){
+	return &this->m_textureCache;
+}
+
+uint32_t Knee::PortalViewTree::getPassCount(){
+	return this->m_passCount;
+}
+
+uint32_t Knee::PortalViewTree::getPassBudget(){
+	return this->m_passBudget;
+}
+
+void Knee::PortalViewTree::setPassBudget(uint32_t passBudget){
+	this->m_passBudget = passBudget;
+}
+
+uint32_t Knee::PortalViewTree::getLayerMask(){
+	return this->m_layerMask;
+}
+
+void Knee::PortalViewTree::setLayerMask(uint32_t layerMask){
+	this->m_layerMask = layerMask;
+}
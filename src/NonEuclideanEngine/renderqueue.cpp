@@ -0,0 +1,88 @@
+#include <NonEuclideanEngine/renderqueue.hpp>
+
+#include <algorithm>
+
+// -------------------- //
+// RenderQueue //
+
+Knee::RenderQueue::RenderQueue(){}
+
+uint64_t Knee::RenderQueue::makeKey(uint32_t layer, bool custom, uint32_t program, uint32_t texture, uint32_t vertexArray, float depth){
+	// anything past the far plane (or behind the camera) gets clamped, it's only an ordering hint
+	depth = std::min(std::max(depth, 0.0f), 1.0f);
+
+	uint64_t key = layer & ((1u << Knee::RenderQueue::LAYER_BITS) - 1);
+
+	key = (key << Knee::RenderQueue::CUSTOM_BITS) | (custom ? 1 : 0);
+	key = (key << Knee::RenderQueue::PROGRAM_BITS) | (program & ((1u << Knee::RenderQueue::PROGRAM_BITS) - 1));
+	key = (key << Knee::RenderQueue::TEXTURE_BITS) | (texture & ((1u << Knee::RenderQueue::TEXTURE_BITS) - 1));
+	key = (key << Knee::RenderQueue::VERTEX_ARRAY_BITS) | (vertexArray & ((1u << Knee::RenderQueue::VERTEX_ARRAY_BITS) - 1));
+	key = (key << Knee::RenderQueue::DEPTH_BITS) | (uint64_t)(depth * ((1u << Knee::RenderQueue::DEPTH_BITS) - 1));
+
+	return key;
+}
+
+void Knee::RenderQueue::clear(){
+	this->m_packets.clear();
+}
+
+void Knee::RenderQueue::push(uint64_t key, uint32_t index){
+	this->m_packets.push_back({ key, index });
+}
+
+void Knee::RenderQueue::sort(){
+	uint32_t count = this->m_packets.size();
+
+	if(count < 2) return;
+
+	// count every byte of every key in one go
+	std::vector<uint32_t> histograms(Knee::RenderQueue::RADIX_PASSES * Knee::RenderQueue::RADIX_SIZE, 0);
+
+	for(uint32_t i = 0; i < count; i++){
+		uint64_t key = this->m_packets.at(i).key;
+
+		for(uint32_t pass = 0; pass < Knee::RenderQueue::RADIX_PASSES; pass++){
+			histograms.at(pass * Knee::RenderQueue::RADIX_SIZE + ((key >> (pass * Knee::RenderQueue::RADIX_BITS)) & (Knee::RenderQueue::RADIX_SIZE - 1)))++;
+		}
+	}
+
+	this->m_sortBuffer.resize(count);
+
+	for(uint32_t pass = 0; pass < Knee::RenderQueue::RADIX_PASSES; pass++){
+		uint32_t* histogram = histograms.data() + pass * Knee::RenderQueue::RADIX_SIZE;
+		uint32_t shift = pass * Knee::RenderQueue::RADIX_BITS;
+
+		// a byte that's the same in every key wouldn't move anything
+		if(histogram[(this->m_packets.at(0).key >> shift) & (Knee::RenderQueue::RADIX_SIZE - 1)] == count) continue;
+
+		// turn counts into where each byte's packets start
+		uint32_t offset = 0;
+
+		for(uint32_t i = 0; i < Knee::RenderQueue::RADIX_SIZE; i++){
+			uint32_t size = histogram[i];
+
+			histogram[i] = offset;
+			offset += size;
+		}
+
+		for(uint32_t i = 0; i < count; i++){
+			const Knee::RenderQueue::Packet& packet = this->m_packets[i];
+
+			this->m_sortBuffer[histogram[(packet.key >> shift) & (Knee::RenderQueue::RADIX_SIZE - 1)]++] = packet;
+		}
+
+		this->m_packets.swap(this->m_sortBuffer);
+	}
+}
+
+uint32_t Knee::RenderQueue::getSize(){
+	return this->m_packets.size();
+}
+
+uint64_t Knee::RenderQueue::getKey(uint32_t i){
+	return this->m_packets.at(i).key;
+}
+
+uint32_t Knee::RenderQueue::getIndex(uint32_t i){
+	return this->m_packets.at(i).index;
+}
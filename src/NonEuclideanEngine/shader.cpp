@@ -1,10 +1,15 @@
 #include <NonEuclideanEngine/shader.hpp>
+#include <NonEuclideanEngine/mesh.hpp>
 #include <NonEuclideanEngine/fileio.hpp>
 #include <NonEuclideanEngine/misc.hpp>
+#include <NonEuclideanEngine/glstate.hpp>
 
 #include <glad/glad.h>
+#include <glm/gtc/packing.hpp>
 #include <iostream>
 #include <string>
+#include <algorithm>
+#include <cstring>
 #include <math.h>
 
 // default max texture units (none)
@@ -33,7 +38,219 @@ const uint32_t Knee::VertexData::VA_NORMAL_INDEX = 2;
 //			"tp" = texture coordinates then position
 //			"pnt" = position, normals, texture coordinates
 // the indices of attributes in shaders will always map 0 to position, 1 to texture coordinates, and 2 to normals
-Knee::VertexData::VertexData(float* data, uint32_t vertexCount, GLsizeiptr dataSize, std::string attributeOrder) : m_vertexCount(vertexCount) {
+Knee::VertexData::VertexData(float* data, uint32_t vertexCount, GLsizeiptr dataSize, std::string attributeOrder, uint32_t lodCount, uint32_t packing) : m_attributeOrder(attributeOrder), m_stride(getAttributeOrderStride(attributeOrder)) {
+	// never read past the end of the data
+	if(this->m_stride > 0) vertexCount = std::min(vertexCount, (uint32_t)(dataSize / (this->m_stride * sizeof(float))));
+
+	// identical vertices (like the corners shared by a cube face's two triangles) are only stored + transformed once
+	std::vector<float> vertices;
+	std::vector<uint32_t> indices;
+
+	Knee::MeshIndexer::index(data, vertexCount, this->m_stride, vertices, indices);
+
+	this->create(vertices, indices, packing);
+
+	// nothing to simplify
+	int32_t positionOffset = this->getAttributeOffset(Knee::VertexData::VA_POSITION_STR);
+
+	if(lodCount == 0 || positionOffset < 0) return;
+
+	std::vector<Knee::MeshLOD> lods;
+	Knee::MeshSimplifier::generateLODs(data, vertexCount, this->m_stride, positionOffset, lodCount, lods);
+
+	for(uint32_t i = 0; i < lods.size(); i++){
+		Knee::MeshLOD& lod = lods.at(i);
+
+		this->m_lods.push_back(new Knee::VertexData(lod.data.data(), lod.vertexCount, lod.data.size() * sizeof(float), attributeOrder, 0, packing));
+		this->m_lodErrors.push_back(lod.error);
+	}
+}
+
+Knee::VertexData::VertexData(float* data, uint32_t vertexCount, GLsizeiptr dataSize, std::string attributeOrder, const std::vector<uint32_t>& indices, uint32_t packing) : m_attributeOrder(attributeOrder), m_stride(getAttributeOrderStride(attributeOrder)) {
+	if(this->m_stride > 0) vertexCount = std::min(vertexCount, (uint32_t)(dataSize / (this->m_stride * sizeof(float))));
+
+	std::vector<float> vertexList(data, data + vertexCount * this->m_stride);
+	std::vector<uint32_t> indexList;
+
+	// indices that point past the data are dropped along with their triangle
+	for(uint32_t i = 0; i + 2 < indices.size(); i += 3){
+		if(indices.at(i) >= vertexCount || indices.at(i + 1) >= vertexCount || indices.at(i + 2) >= vertexCount) continue;
+
+		indexList.insert(indexList.end(), indices.begin() + i, indices.begin() + i + 3);
+	}
+
+	this->create(vertexList, indexList, packing);
+}
+
+uint32_t Knee::VertexData::getAttributeOrderStride(std::string attributeOrder){
+	uint32_t stride = 0;
+
+	if(attributeOrder.find(Knee::VertexData::VA_POSITION_STR) != std::string::npos) stride += Knee::VertexData::VA_POSITION_SIZE;
+	if(attributeOrder.find(Knee::VertexData::VA_TEXCOORD_STR) != std::string::npos) stride += Knee::VertexData::VA_TEXCOORD_SIZE;
+	if(attributeOrder.find(Knee::VertexData::VA_NORMAL_STR) != std::string::npos) stride += Knee::VertexData::VA_NORMAL_SIZE;
+
+	return stride;
+}
+
+void Knee::VertexData::setAttributeFormats(const std::vector<float>& vertices, uint32_t packing){
+	int32_t texCoordOffset = this->getAttributeOffset(Knee::VertexData::VA_TEXCOORD_STR);
+
+	// normalized integers can't hold anything outside of 0-1
+	if((packing & VERTEX_PACKING_UNORM16_TEXCOORDS) && texCoordOffset >= 0){
+		for(uint32_t i = texCoordOffset; i < vertices.size(); i += this->m_stride){
+			if(vertices.at(i) < 0.0f || vertices.at(i) > 1.0f || vertices.at(i + 1) < 0.0f || vertices.at(i + 1) > 1.0f){
+				packing &= ~VERTEX_PACKING_UNORM16_TEXCOORDS;
+				break;
+			}
+		}
+	}
+
+	// only one format can be used
+	if(packing & VERTEX_PACKING_UNORM16_TEXCOORDS) packing &= ~VERTEX_PACKING_HALF_TEXCOORDS;
+
+	this->m_packing = packing;
+	this->m_attributeFormats.clear();
+	this->m_vertexSize = 0;
+
+	for(uint32_t i = 0; i < this->m_attributeOrder.length(); i++){
+		std::string attribute = this->m_attributeOrder.substr(i, 1);
+
+		Knee::VertexData::AttributeFormat format;
+		format.floatOffset = this->getAttributeOffset(attribute);
+		format.byteOffset = this->m_vertexSize;
+
+		// bytes before padding
+		uint32_t size = 0;
+
+		if(attribute == Knee::VertexData::VA_POSITION_STR){
+			format.index = Knee::VertexData::VA_POSITION_INDEX;
+			format.size = Knee::VertexData::VA_POSITION_SIZE;
+
+			if(packing & VERTEX_PACKING_HALF_POSITIONS) format.type = GL_HALF_FLOAT;
+		} else if(attribute == Knee::VertexData::VA_TEXCOORD_STR){
+			format.index = Knee::VertexData::VA_TEXCOORD_INDEX;
+			format.size = Knee::VertexData::VA_TEXCOORD_SIZE;
+
+			if(packing & VERTEX_PACKING_UNORM16_TEXCOORDS){
+				format.type = GL_UNSIGNED_SHORT;
+				format.normalized = GL_TRUE;
+			} else if(packing & VERTEX_PACKING_HALF_TEXCOORDS){
+				format.type = GL_HALF_FLOAT;
+			}
+		} else if(attribute == Knee::VertexData::VA_NORMAL_STR){
+			format.index = Knee::VertexData::VA_NORMAL_INDEX;
+			format.size = Knee::VertexData::VA_NORMAL_SIZE;
+
+			if(packing & VERTEX_PACKING_PACKED_NORMALS){
+				// the fourth component is the 2 bit w, which the shader ignores
+				format.type = GL_INT_2_10_10_10_REV;
+				format.size = 4;
+				format.normalized = GL_TRUE;
+			}
+		} else {
+			continue;
+		}
+
+		if(format.type == GL_FLOAT){
+			size = format.size * sizeof(float);
+		} else if(format.type == GL_INT_2_10_10_10_REV){
+			size = sizeof(uint32_t);
+		} else {
+			size = format.size * sizeof(uint16_t);
+		}
+
+		// every attribute starts 4 byte aligned
+		this->m_vertexSize += (size + 3) & ~3u;
+
+		this->m_attributeFormats.push_back(format);
+	}
+}
+
+void Knee::VertexData::packAttribute(const Knee::VertexData::AttributeFormat& format, const float* in, uint8_t* out){
+	switch(format.type){
+		case GL_HALF_FLOAT: {
+			uint16_t* half = (uint16_t*)out;
+
+			for(GLint i = 0; i < format.size; i++) half[i] = glm::packHalf1x16(in[i]);
+
+			break;
+		}
+		case GL_UNSIGNED_SHORT: {
+			uint16_t* unorm = (uint16_t*)out;
+
+			for(GLint i = 0; i < format.size; i++) unorm[i] = glm::packUnorm1x16(in[i]);
+
+			break;
+		}
+		case GL_INT_2_10_10_10_REV: {
+			uint32_t packed = glm::packSnorm3x10_1x2(glm::vec4(in[0], in[1], in[2], 0.0f));
+
+			memcpy(out, &packed, sizeof(uint32_t));
+
+			break;
+		}
+		default:
+			memcpy(out, in, format.size * sizeof(float));
+	}
+}
+
+void Knee::VertexData::unpackAttribute(const Knee::VertexData::AttributeFormat& format, const uint8_t* in, float* out){
+	switch(format.type){
+		case GL_HALF_FLOAT: {
+			const uint16_t* half = (const uint16_t*)in;
+
+			for(GLint i = 0; i < format.size; i++) out[i] = glm::unpackHalf1x16(half[i]);
+
+			break;
+		}
+		case GL_UNSIGNED_SHORT: {
+			const uint16_t* unorm = (const uint16_t*)in;
+
+			for(GLint i = 0; i < format.size; i++) out[i] = glm::unpackUnorm1x16(unorm[i]);
+
+			break;
+		}
+		case GL_INT_2_10_10_10_REV: {
+			uint32_t packed;
+			memcpy(&packed, in, sizeof(uint32_t));
+
+			glm::vec4 normal = glm::unpackSnorm3x10_1x2(packed);
+
+			out[0] = normal.x;
+			out[1] = normal.y;
+			out[2] = normal.z;
+
+			break;
+		}
+		default:
+			memcpy(out, in, format.size * sizeof(float));
+	}
+}
+
+void Knee::VertexData::create(std::vector<float>& vertices, std::vector<uint32_t>& indices, uint32_t packing){
+	// triangles that share vertices are drawn close together, then vertices are stored in the order they're drawn
+	Knee::MeshIndexer::optimizeVertexCache(indices, this->m_stride > 0 ? vertices.size() / this->m_stride : 0);
+	Knee::MeshIndexer::optimizeVertexFetch(vertices, this->m_stride, indices);
+
+	float* data = vertices.data();
+	uint32_t vertexCount = this->m_stride > 0 ? vertices.size() / this->m_stride : 0;
+
+	this->m_vertexCount = vertexCount;
+	this->m_indexCount = indices.size();
+
+	this->setAttributeFormats(vertices, packing);
+
+	// pack every vertex into the buffer's layout
+	std::vector<uint8_t> packed(vertexCount * this->m_vertexSize, 0);
+
+	for(uint32_t i = 0; i < vertexCount; i++){
+		for(uint32_t j = 0; j < this->m_attributeFormats.size(); j++){
+			const Knee::VertexData::AttributeFormat& format = this->m_attributeFormats.at(j);
+
+			Knee::VertexData::packAttribute(format, data + i*this->m_stride + format.floatOffset, packed.data() + i*this->m_vertexSize + format.byteOffset);
+		}
+	}
+
 	// create vertex buffer object
 	glGenBuffers(1, &this->m_vbo);
 	
@@ -41,112 +258,203 @@ Knee::VertexData::VertexData(float* data, uint32_t vertexCount, GLsizeiptr dataS
 	glBindBuffer(GL_ARRAY_BUFFER, this->m_vbo);
 	
 	// copy data
-	glBufferData(GL_ARRAY_BUFFER, dataSize, data, GL_STATIC_DRAW);
+	glBufferData(GL_ARRAY_BUFFER, packed.size(), packed.data(), GL_STATIC_DRAW);
 	
 	// create vertex array object
 	glGenVertexArrays(1, &this->m_vao);
 	
 	// bind vertex array for modification
-	glBindVertexArray(this->m_vao);
-	
+	Knee::GLState::bindVertexArray(this->m_vao);
+
+	// create element buffer object, which stays bound to the vao
+	glGenBuffers(1, &this->m_ebo);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, this->m_ebo);
+
+	// half the size when every vertex can be reached with 16 bits
+	if(vertexCount <= 0x10000){
+		std::vector<uint16_t> shortIndices(indices.begin(), indices.end());
+
+		this->m_indexType = GL_UNSIGNED_SHORT;
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, shortIndices.size() * sizeof(uint16_t), shortIndices.data(), GL_STATIC_DRAW);
+	} else {
+		this->m_indexType = GL_UNSIGNED_INT;
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(uint32_t), indices.data(), GL_STATIC_DRAW);
+	}
+
 	// create vertex attribute pointers
-	size_t positionIndex = attributeOrder.find(Knee::VertexData::VA_POSITION_STR);
-	size_t texCoordIndex = attributeOrder.find(Knee::VertexData::VA_TEXCOORD_STR);
-	size_t normalIndex = attributeOrder.find(Knee::VertexData::VA_NORMAL_STR);
-	
-	bool hasPositions = positionIndex != std::string::npos;
-	bool hasTexCoords = texCoordIndex != std::string::npos;
-	bool hasNormals = normalIndex != std::string::npos;
-	
-	uint32_t positionSize = hasPositions ? Knee::VertexData::VA_POSITION_SIZE : 0;
-	uint32_t texCoordSize = hasTexCoords ? Knee::VertexData::VA_TEXCOORD_SIZE : 0;
-	uint32_t normalSize = hasNormals ? Knee::VertexData::VA_NORMAL_SIZE : 0;
-	
-	uint32_t stride = positionSize + texCoordSize + normalSize;
+	for(uint32_t i = 0; i < this->m_attributeFormats.size(); i++){
+		const Knee::VertexData::AttributeFormat& format = this->m_attributeFormats.at(i);
 
-	// vertex position pointer
-	if(hasPositions){
-		uint32_t offset = 0;
-		
-		if(positionIndex == 0){
-			offset = 0;
-		} else if(positionIndex == 2){
-			offset = texCoordSize + normalSize;;
-		} else {
-			if(hasTexCoords && texCoordIndex == 0){
-				offset = texCoordSize;
-			} else {
-				offset = normalSize;
-			}
-		}
+		glVertexAttribPointer(format.index, format.size, format.type, format.normalized, this->m_vertexSize, (GLvoid*)(size_t)format.byteOffset);
 
-		glVertexAttribPointer(Knee::VertexData::VA_POSITION_INDEX, positionSize, GL_FLOAT, GL_FALSE, stride * sizeof(float), (GLvoid*)(offset * sizeof(float)));
-	
-		glEnableVertexAttribArray(Knee::VertexData::VA_POSITION_INDEX);
+		glEnableVertexAttribArray(format.index);
 	}
-	
-	// vertex tex coords pointer
-	if(hasTexCoords){
-		uint32_t offset = 0;
-		
-		if(texCoordIndex == 0){
-			offset = 0;
-		} else if(texCoordIndex == 2){
-			offset = positionSize + normalSize;
-		} else {
-			if(hasPositions && positionIndex == 0){
-				offset = positionSize;
-			} else {
-				offset = normalSize;
-			}
+
+	// calculate bounds for culling, from the unpacked positions
+	int32_t positionOffset = this->getAttributeOffset(Knee::VertexData::VA_POSITION_STR);
+
+	if(positionOffset >= 0){
+		glm::vec3 min = glm::vec3(INFINITY);
+		glm::vec3 max = glm::vec3(-INFINITY);
+
+		for(uint32_t i = 0; i < vertexCount; i++){
+			float* p = data + i*this->m_stride + positionOffset;
+
+			min = glm::min(min, glm::vec3(p[0], p[1], p[2]));
+			max = glm::max(max, glm::vec3(p[0], p[1], p[2]));
 		}
-		
-		glVertexAttribPointer(Knee::VertexData::VA_TEXCOORD_INDEX, texCoordSize, GL_FLOAT, GL_FALSE, stride * sizeof(float), (GLvoid*)(offset * sizeof(float)));
 
-		glEnableVertexAttribArray(Knee::VertexData::VA_TEXCOORD_INDEX);
-	}
+		if(vertexCount > 0){
+			this->m_boundingCenter = (min + max) / 2.f;
 
-	// vertex normals pointer
-	if(hasNormals){
-		uint32_t offset = 0;
-		
-		if(normalIndex == 0){
-			offset = 0;
-		} else if(normalIndex == 2){
-			offset = positionSize + texCoordSize;
-		} else {
-			if(hasPositions && positionIndex == 0){
-				offset = positionSize;
-			} else {
-				offset = texCoordSize;
+			for(uint32_t i = 0; i < vertexCount; i++){
+				float* p = data + i*this->m_stride + positionOffset;
+
+				this->m_boundingRadius = std::max(this->m_boundingRadius, glm::length(glm::vec3(p[0], p[1], p[2]) - this->m_boundingCenter));
 			}
+
+			// half float positions can be rounded out by up to about a thousandth
+			if(this->m_packing & VERTEX_PACKING_HALF_POSITIONS) this->m_boundingRadius += (glm::length(this->m_boundingCenter) + this->m_boundingRadius) / 1024.0f;
 		}
-		
-		glEnableVertexAttribArray(Knee::VertexData::VA_NORMAL_INDEX);
-		
-		glVertexAttribPointer(Knee::VertexData::VA_NORMAL_INDEX, normalSize, GL_FLOAT, GL_FALSE, stride * sizeof(float), (GLvoid*)(offset * sizeof(float)));
+	} else {
+		// nothing to bound, so never cull
+		this->m_boundingRadius = INFINITY;
 	}
 	
-	// unbind everything
+	// unbind everything (the element buffer has to stay bound until the vao isn't)
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
-	glBindVertexArray(0);
+	Knee::GLState::bindVertexArray(0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 }
 
 Knee::VertexData::~VertexData(){
-	// delete vbo
+	// delete vbo + ebo
 	glDeleteBuffers(1, &this->m_vbo);
+	glDeleteBuffers(1, &this->m_ebo);
 	
 	// delete vao
-	glDeleteVertexArrays(1, &this->m_vao);
+	Knee::GLState::deleteVertexArray(this->m_vao);
+
+	// delete levels of detail
+	for(uint32_t i = 0; i < this->m_lods.size(); i++){
+		delete this->m_lods.at(i);
+	}
 }
 
 uint32_t Knee::VertexData::getVertexCount() const {
 	return this->m_vertexCount;
 }
 
+uint32_t Knee::VertexData::getIndexCount() const {
+	return this->m_indexCount;
+}
+
+GLenum Knee::VertexData::getIndexType() const {
+	return this->m_indexType;
+}
+
+glm::vec3 Knee::VertexData::getBoundingCenter() const {
+	return this->m_boundingCenter;
+}
+
+float Knee::VertexData::getBoundingRadius() const {
+	return this->m_boundingRadius;
+}
+
+uint32_t Knee::VertexData::getLODCount() const {
+	return this->m_lods.size();
+}
+
+const Knee::VertexData* Knee::VertexData::getLOD(float pixelsPerUnit) const {
+	// simplest first
+	for(int32_t i = (int32_t)this->m_lods.size() - 1; i >= 0; i--){
+		if(this->m_lodErrors.at(i) * pixelsPerUnit <= Knee::VertexData::MAX_LOD_PIXEL_ERROR) return this->m_lods.at(i);
+	}
+
+	return this;
+}
+
+GLuint Knee::VertexData::getGLVertexArray() const {
+	return this->m_vao;
+}
+
+std::string Knee::VertexData::getAttributeOrder() const {
+	return this->m_attributeOrder;
+}
+
+uint32_t Knee::VertexData::getStride() const {
+	return this->m_stride;
+}
+
+uint32_t Knee::VertexData::getPacking() const {
+	return this->m_packing;
+}
+
+uint32_t Knee::VertexData::getVertexSize() const {
+	return this->m_vertexSize;
+}
+
+int32_t Knee::VertexData::getAttributeOffset(std::string attribute) const {
+	uint32_t offset = 0;
+
+	for(uint32_t i = 0; i < this->m_attributeOrder.length(); i++){
+		std::string current = this->m_attributeOrder.substr(i, 1);
+
+		if(current == attribute) return offset;
+
+		if(current == Knee::VertexData::VA_POSITION_STR){
+			offset += Knee::VertexData::VA_POSITION_SIZE;
+		} else if(current == Knee::VertexData::VA_TEXCOORD_STR){
+			offset += Knee::VertexData::VA_TEXCOORD_SIZE;
+		} else if(current == Knee::VertexData::VA_NORMAL_STR){
+			offset += Knee::VertexData::VA_NORMAL_SIZE;
+		}
+	}
+
+	return -1;
+}
+
+void Knee::VertexData::readData(std::vector<float>& data) const {
+	data.resize(this->m_vertexCount * this->m_stride);
+
+	if(data.empty()) return;
+
+	std::vector<uint8_t> packed(this->m_vertexCount * this->m_vertexSize);
+
+	glBindBuffer(GL_ARRAY_BUFFER, this->m_vbo);
+	glGetBufferSubData(GL_ARRAY_BUFFER, 0, packed.size(), packed.data());
+
+	for(uint32_t i = 0; i < this->m_vertexCount; i++){
+		for(uint32_t j = 0; j < this->m_attributeFormats.size(); j++){
+			const Knee::VertexData::AttributeFormat& format = this->m_attributeFormats.at(j);
+
+			Knee::VertexData::unpackAttribute(format, packed.data() + i*this->m_vertexSize + format.byteOffset, data.data() + i*this->m_stride + format.floatOffset);
+		}
+	}
+}
+
+void Knee::VertexData::readIndices(std::vector<uint32_t>& indices) const {
+	indices.resize(this->m_indexCount);
+
+	if(indices.empty()) return;
+
+	// the element buffer binding belongs to the vao
+	Knee::GLState::bindVertexArray(this->m_vao);
+
+	if(this->m_indexType == GL_UNSIGNED_SHORT){
+		std::vector<uint16_t> shortIndices(this->m_indexCount);
+
+		glGetBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, shortIndices.size() * sizeof(uint16_t), shortIndices.data());
+
+		indices.assign(shortIndices.begin(), shortIndices.end());
+	} else {
+		glGetBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, indices.size() * sizeof(uint32_t), indices.data());
+	}
+}
+
 // use this vertex data for vertex attributes for all shader calls following (until another is used instead)
 void Knee::VertexData::use() const {
-	glBindVertexArray(this->m_vao);
+	Knee::GLState::bindVertexArray(this->m_vao);
 }
 
 // -------------------- //
@@ -166,6 +474,10 @@ bool Knee::ShaderProgram::isCompiled(){
 	return this->m_compiled;
 }
 
+GLuint Knee::ShaderProgram::getGLProgram(){
+	return this->m_program;
+}
+
 uint32_t Knee::ShaderProgram::getMaxTextureUnits(){
 	return Knee::ShaderProgram::MAX_TEXTURE_UNITS;
 }
@@ -178,20 +490,21 @@ void Knee::ShaderProgram::loadMaxTextureUnits(){
 
 // bind a 2D texture to a uniform in this shader program
 void Knee::ShaderProgram::bindTexture2D(std::string uniformName, Knee::Texture2D* texture){
+	this->bindTexture2D(this->getUniform<GLint>(uniformName), texture);
+}
+
+void Knee::ShaderProgram::bindTexture2D(const Knee::Uniform<GLint>& sampler, Knee::Texture2D* texture){
 	// check if we would be exceeding the maximum texture units supported
 	if(this->m_boundTextureCount >= this->getMaxTextureUnits()){
 		std::cout << Knee::WARNING_PREFACE << "Attempted to bind more textures than maximum supported (" << this->getMaxTextureUnits() << ")" << std::endl;
 		return;
 	}
 
-	// set active texture
-	glActiveTexture(GL_TEXTURE0 + this->m_boundTextureCount);
-
-	// bind the texture name to the working 2D texture
-	glBindTexture(GL_TEXTURE_2D, texture->getGLTexture());
+	// bind the texture name to the working 2D texture of the unit
+	Knee::GLState::bindTexture(this->m_boundTextureCount, GL_TEXTURE_2D, texture->getGLTexture());
 
 	// set uniform
-	glUniform1i(this->getUniformLocation(uniformName), this->m_boundTextureCount);
+	this->setUniform(sampler, (GLint)this->m_boundTextureCount);
 
 	// increment number of bound textures
 	this->m_boundTextureCount++;
@@ -320,6 +633,10 @@ int32_t Knee::ShaderProgram::compile(){
 	
 	// load uniforms
 	this->loadUniformLocations();
+	this->loadUniforms();
+
+	// read the camera from its uniform buffer if the shader needs it
+	this->setUniformBlockBinding(Knee::PerspectiveCamera::UNIFORM_BLOCK_NAME, Knee::PerspectiveCamera::UNIFORM_BLOCK_BINDING);
 	
 	return 0;
 }
@@ -336,12 +653,15 @@ void Knee::ShaderProgram::markAttachedShadersForDeletion(){
 void Knee::ShaderProgram::destroy(){
 	this->markAttachedShadersForDeletion();
 	
-	glDeleteProgram(this->m_program);
+	Knee::GLState::deleteProgram(this->m_program);
 }
 
 int32_t Knee::ShaderProgram::loadUniformLocations(){
 	if(!this->isCompiled()) return -1;
 	
+	this->m_uniforms.clear();
+	this->m_uniformSlots.clear();
+
 	// get number of active uniforms
 	GLint numUniforms = 0;
 	
@@ -366,45 +686,130 @@ int32_t Knee::ShaderProgram::loadUniformLocations(){
 		if(location == -1) continue;
 		
 		// save to uniform manager
-		this->m_uniforms[name] = location;
+		Knee::ShaderProgram::UniformSlot slot;
+		slot.location = location;
+
+		this->m_uniforms[name] = this->m_uniformSlots.size();
+		this->m_uniformSlots.push_back(slot);
 	}
 	
 	return 0;
 }
 
-// sets the value at the uniform location in this shader to the provided mat4.  returns true if the uniform was found, false if otherwise.
-bool Knee::ShaderProgram::setUniformMat4(std::string name, glm::mat4 matrix){
-	GLint location = this->getUniformLocation(name);
-	
-	if(location == -1) return false;
-	
+void Knee::ShaderProgram::loadUniforms(){}
+
+int32_t Knee::ShaderProgram::getUniformSlot(std::string name){
+	std::map<std::string, uint32_t>::iterator it = this->m_uniforms.find(name);
+
+	if(it == this->m_uniforms.end()) return -1;
+
+	return it->second;
+}
+
+bool Knee::ShaderProgram::updateUniformValue(int32_t slot, const void* value, size_t size){
+	Knee::ShaderProgram::UniformSlot& uniformSlot = this->m_uniformSlots[slot];
+
+	if(uniformSlot.hasValue && memcmp(uniformSlot.value, value, size) == 0) return false;
+
+	memcpy(uniformSlot.value, value, size);
+	uniformSlot.hasValue = true;
+
+	// uniforms are set on whichever program is in use
 	this->use();
+
+	return true;
+}
+
+void Knee::ShaderProgram::setUniform(const Knee::Uniform<GLint>& uniform, GLint value){
+	if(!uniform.exists() || !this->updateUniformValue(uniform.slot, &value, sizeof(value))) return;
+
+	glUniform1i(this->m_uniformSlots[uniform.slot].location, value);
+}
+
+void Knee::ShaderProgram::setUniform(const Knee::Uniform<bool>& uniform, bool value){
+	GLint intValue = value ? 1 : 0;
+
+	if(!uniform.exists() || !this->updateUniformValue(uniform.slot, &intValue, sizeof(intValue))) return;
+
+	glUniform1i(this->m_uniformSlots[uniform.slot].location, intValue);
+}
+
+void Knee::ShaderProgram::setUniform(const Knee::Uniform<float>& uniform, float value){
+	if(!uniform.exists() || !this->updateUniformValue(uniform.slot, &value, sizeof(value))) return;
+
+	glUniform1f(this->m_uniformSlots[uniform.slot].location, value);
+}
+
+void Knee::ShaderProgram::setUniform(const Knee::Uniform<glm::vec4>& uniform, glm::vec4 value){
+	if(!uniform.exists() || !this->updateUniformValue(uniform.slot, glm::value_ptr(value), sizeof(value))) return;
+
+	glUniform4fv(this->m_uniformSlots[uniform.slot].location, 1, glm::value_ptr(value));
+}
+
+void Knee::ShaderProgram::setUniform(const Knee::Uniform<glm::mat3>& uniform, const glm::mat3& value){
+	if(!uniform.exists() || !this->updateUniformValue(uniform.slot, glm::value_ptr(value), sizeof(value))) return;
+
+	glUniformMatrix3fv(this->m_uniformSlots[uniform.slot].location, 1, GL_FALSE, glm::value_ptr(value));
+}
+
+void Knee::ShaderProgram::setUniform(const Knee::Uniform<glm::mat4>& uniform, const glm::mat4& value){
+	if(!uniform.exists() || !this->updateUniformValue(uniform.slot, glm::value_ptr(value), sizeof(value))) return;
+
+	glUniformMatrix4fv(this->m_uniformSlots[uniform.slot].location, 1, GL_FALSE, glm::value_ptr(value));
+}
+
+// sets the value at the uniform location in this shader to the provided mat3.  returns true if the uniform was found, false if otherwise.
+bool Knee::ShaderProgram::setUniformMat3(std::string name, glm::mat3 matrix){
+	Knee::Uniform<glm::mat3> uniform = this->getUniform<glm::mat3>(name);
+
+	this->setUniform(uniform, matrix);
 	
-	glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(matrix));
+	return uniform.exists();
+}
+
+// sets the value at the uniform location in this shader to the provided mat4.  returns true if the uniform was found, false if otherwise.
+bool Knee::ShaderProgram::setUniformMat4(std::string name, glm::mat4 matrix){
+	Knee::Uniform<glm::mat4> uniform = this->getUniform<glm::mat4>(name);
+
+	this->setUniform(uniform, matrix);
 	
+	return uniform.exists();
+}
+
+bool Knee::ShaderProgram::setUniformBlockBinding(std::string name, GLuint binding){
+	GLuint index = glGetUniformBlockIndex(this->m_program, name.c_str());
+
+	if(index == GL_INVALID_INDEX) return false;
+
+	glUniformBlockBinding(this->m_program, index, binding);
+
 	return true;
 }
 
 void Knee::ShaderProgram::use(){
-	glUseProgram(this->m_program);
+	Knee::GLState::useProgram(this->m_program);
 }
 
 GLint Knee::ShaderProgram::getUniformLocation(std::string name){
-	GLint out = -1;
-	
-	try {
-		out = this->m_uniforms.at(name);
-	} catch( const std::out_of_range& e ){
-		out = -1;
-	}
-	
-	return out;
+	int32_t slot = this->getUniformSlot(name);
+
+	if(slot < 0) return -1;
+
+	return this->m_uniformSlots[slot].location;
 }
 
 void Knee::ShaderProgram::drawArrays(uint32_t count){
 	glDrawArrays(GL_TRIANGLES, 0, count);
 }
 
+void Knee::ShaderProgram::drawElements(const Knee::VertexData* vertexData){
+	glDrawElements(GL_TRIANGLES, vertexData->getIndexCount(), vertexData->getIndexType(), (GLvoid*)0);
+}
+
+void Knee::ShaderProgram::drawElementsInstanced(const Knee::VertexData* vertexData, uint32_t instanceCount){
+	glDrawElementsInstanced(GL_TRIANGLES, vertexData->getIndexCount(), vertexData->getIndexType(), (GLvoid*)0, instanceCount);
+}
+
 void Knee::ShaderProgram::drawVertexData(const Knee::VertexData* vertexData){
 	// enable this shader
 	this->use();
@@ -412,13 +817,15 @@ void Knee::ShaderProgram::drawVertexData(const Knee::VertexData* vertexData){
 	// enable vertex data
 	vertexData->use();
 	
-	// draw arrays
-	this->drawArrays(vertexData->getVertexCount());
+	// draw elements
+	this->drawElements(vertexData);
 }
 
 // -------------------- //
 // Camera //
 
+const float Knee::Camera::MIN_CLIP_PLANE_DISTANCE = 0.001f;
+
 Knee::Camera::Camera(){
 	this->setPosition(glm::vec3(0));
 	this->setRotation(glm::vec3(0));
@@ -440,6 +847,14 @@ glm::mat4 Knee::Camera::getViewProjectionMatrix(){
 	return this->m_vpMatrix;
 }
 
+glm::mat4 Knee::Camera::getRenderProjectionMatrix(){
+	return this->m_renderProjectionMatrix;
+}
+
+uint64_t Knee::Camera::getVersion(){
+	return this->m_version;
+}
+
 void Knee::Camera::updateViewMatrix(){
 	// calculate up vector
 	glm::vec3 up = this->getLocalYAxis();
@@ -450,7 +865,22 @@ void Knee::Camera::updateViewMatrix(){
 void Knee::Camera::updateViewProjectionMatrix(){
 	this->updateViewMatrix();
 	
-	this->m_vpMatrix = this->getProjectionMatrix() * this->getViewMatrix();
+	glm::mat4 projection = this->getProjectionMatrix();
+
+	if(this->m_useClipPlane){
+		// planes transform by the inverse transpose
+		glm::vec4 viewSpacePlane = glm::transpose(glm::inverse(this->getViewMatrix())) * this->m_clipPlane;
+
+		// the camera has to be behind the plane, otherwise the frustum would be inside out.  if it's close enough to be on it, precision is too bad to be worth it anyways
+		if(viewSpacePlane.w < -Knee::Camera::MIN_CLIP_PLANE_DISTANCE){
+			projection = Knee::Camera::getObliqueProjectionMatrix(projection, viewSpacePlane);
+		}
+	}
+	
+	this->m_renderProjectionMatrix = this->m_cropMatrix * projection;
+	this->m_vpMatrix = this->m_renderProjectionMatrix * this->getViewMatrix();
+
+	this->m_version++;
 }
 
 void Knee::Camera::setPosition(glm::vec3 position){
@@ -470,12 +900,88 @@ void Knee::Camera::setRotation(glm::vec3 rotation){
 	this->updateViewProjectionMatrix();
 }
 
+void Knee::Camera::setViewportHeight(float viewportHeight){
+	this->m_viewportHeight = viewportHeight;
+}
+
+float Knee::Camera::getViewportHeight(){
+	return this->m_viewportHeight;
+}
+
+float Knee::Camera::getPixelsPerUnit(glm::vec3 center, float radius){
+	if(this->m_viewportHeight <= 0.0f) return INFINITY;
+
+	// w is the distance in front of the camera, for both perspective projections and crops
+	float distance = (this->m_vpMatrix * glm::vec4(center, 1)).w - radius;
+
+	if(distance <= 0.0f) return INFINITY;
+
+	// the crop stretches the projection, so anything seen through it covers more of the viewport
+	return this->m_cropMatrix[1][1] * this->m_projectionMatrix[1][1] * this->m_viewportHeight * 0.5f / distance;
+}
+
+void Knee::Camera::setCrop(const Knee::ScreenRect& crop){
+	this->m_cropMatrix = crop.getCropMatrix();
+}
+
+void Knee::Camera::resetCrop(){
+	this->m_cropMatrix = glm::mat4(1);
+}
+
+void Knee::Camera::setClipPlane(glm::vec4 plane){
+	// normalize so distances to the plane are in world units
+	this->m_clipPlane = plane / glm::length(glm::vec3(plane));
+	this->m_useClipPlane = true;
+}
+
+void Knee::Camera::resetClipPlane(){
+	this->m_useClipPlane = false;
+}
+
+bool Knee::Camera::hasClipPlane(){
+	return this->m_useClipPlane;
+}
+
+glm::vec4 Knee::Camera::getClipPlane(){
+	return this->m_clipPlane;
+}
+
+// Eric Lengyel, "Oblique View Frustum Depth Projection and Clipping"
+// the far plane gets tilted as a side effect, but depth precision is only lost near the clip plane
+glm::mat4 Knee::Camera::getObliqueProjectionMatrix(glm::mat4 projection, glm::vec4 viewSpacePlane){
+	// the corner of the frustum opposite the plane, in view space
+	glm::vec4 q = glm::inverse(projection) * glm::vec4(
+		(viewSpacePlane.x > 0) - (viewSpacePlane.x < 0),
+		(viewSpacePlane.y > 0) - (viewSpacePlane.y < 0),
+		1.0f,
+		1.0f
+	);
+
+	// scale the plane so that corner lands on the far plane
+	glm::vec4 c = viewSpacePlane * (2.0f / glm::dot(viewSpacePlane, q));
+
+	// replace the third row
+	projection[0][2] = c.x - projection[0][3];
+	projection[1][2] = c.y - projection[1][3];
+	projection[2][2] = c.z - projection[2][3];
+	projection[3][2] = c.w - projection[3][3];
+
+	return projection;
+}
+
 // -------------------- //
 // PerspectiveCamera //
 
+const std::string Knee::PerspectiveCamera::UNIFORM_BLOCK_NAME = "Camera";
+const GLuint Knee::PerspectiveCamera::UNIFORM_BLOCK_BINDING = 0;
+
 Knee::PerspectiveCamera::PerspectiveCamera() : Knee::Camera() {
 }
 
+Knee::PerspectiveCamera::~PerspectiveCamera(){
+	if(this->m_uniformBuffer != 0) glDeleteBuffers(1, &this->m_uniformBuffer);
+}
+
 float Knee::PerspectiveCamera::getNear(){
 	return this->m_near;
 }
@@ -505,6 +1011,34 @@ void Knee::PerspectiveCamera::setPerspectiveProperties(float fov, float aspectRa
 	this->updateViewProjectionMatrix();
 }
 
+void Knee::PerspectiveCamera::useUniformBuffer(){
+	if(this->m_uniformBuffer == 0){
+		glGenBuffers(1, &this->m_uniformBuffer);
+		glBindBuffer(GL_UNIFORM_BUFFER, this->m_uniformBuffer);
+		glBufferData(GL_UNIFORM_BUFFER, sizeof(Knee::PerspectiveCamera::UniformBlock), NULL, GL_DYNAMIC_DRAW);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	}
+
+	// only copied when something has changed, which is usually once per pass
+	if(this->m_uniformVersion != this->getVersion()){
+		Knee::PerspectiveCamera::UniformBlock block;
+
+		block.view = this->getViewMatrix();
+		block.projection = this->getRenderProjectionMatrix();
+		block.viewProjection = this->getViewProjectionMatrix();
+		block.position = glm::vec4(this->getPosition(), 1);
+		block.depthRange = glm::vec4(this->m_near, this->m_far, 0, 0);
+
+		glBindBuffer(GL_UNIFORM_BUFFER, this->m_uniformBuffer);
+		glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(Knee::PerspectiveCamera::UniformBlock), &block);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+		this->m_uniformVersion = this->getVersion();
+	}
+
+	glBindBufferBase(GL_UNIFORM_BUFFER, Knee::PerspectiveCamera::UNIFORM_BLOCK_BINDING, this->m_uniformBuffer);
+}
+
 // -------------------- //
 // RenderableObjectShaderProgram //
 
@@ -520,6 +1054,18 @@ Knee::PerspectiveCamera* Knee::RenderableObjectShaderProgram::getCamera(){
 	return this->m_camera;
 }
 
+void Knee::RenderableObjectShaderProgram::loadUniforms(){
+	this->m_uniformHandles.model = this->getUniform<glm::mat4>("u_model");
+	this->m_uniformHandles.instanceBase = this->getUniform<GLint>("u_instanceBase");
+	this->m_uniformHandles.instanceObjects = this->getUniform<GLint>("u_instanceObjects");
+	this->m_uniformHandles.objectTransforms = this->getUniform<GLint>("u_objectTransforms");
+	this->m_uniformHandles.sampler = this->getUniform<GLint>("u_sampler");
+}
+
+const Knee::RenderableObjectUniforms& Knee::RenderableObjectShaderProgram::getUniforms(){
+	return this->m_uniformHandles;
+}
+
 // NOTE: this method will look for certain uniforms (but will silently continue if not found):
 // mvp - (projection * view * model) matrix
 // transposeInverseModel - matrix for transforming the normals such that they match the model after it is transformed by the model matrix.
@@ -550,6 +1096,8 @@ Knee::PerspectiveCamera* Knee::RenderableObjectShaderProgram::getCamera(){
 // -------------------- //
 // RenderableObject //
 
+uint64_t Knee::RenderableObject::LATEST_RENDER_STATE_VERSION = 0;
+
 Knee::RenderableObject::RenderableObject(Knee::VertexData* vertexData, Knee::Texture2D* texture, Knee::RenderableObjectShaderProgram* program) : m_vertexData(vertexData), m_texture(texture), m_shaderProgram(program) {}
 
 Knee::RenderableObjectShaderProgram* Knee::RenderableObject::getShaderProgram(){
@@ -558,6 +1106,8 @@ Knee::RenderableObjectShaderProgram* Knee::RenderableObject::getShaderProgram(){
 
 void Knee::RenderableObject::setShaderProgram(RenderableObjectShaderProgram* program){
 	this->m_shaderProgram = program;
+
+	this->updateRenderStateVersion();
 }
 
 // NOTE: m_vertexData is constant in RenderableObject, so do not attempt to modify
@@ -565,38 +1115,109 @@ const Knee::VertexData* Knee::RenderableObject::getVertexData() const {
 	return this->m_vertexData;
 }
 
+void Knee::RenderableObject::getBoundingSphere(glm::vec3& center, float& radius){
+	center = glm::vec3(this->getModelMatrix() * glm::vec4(this->m_vertexData->getBoundingCenter(), 1));
+
+	// largest scale axis, so that the sphere still contains everything after non uniform scaling
+	glm::vec3 scale = glm::abs(this->getScale());
+
+	radius = this->m_vertexData->getBoundingRadius() * std::max(scale.x, std::max(scale.y, scale.z));
+}
+
 Knee::Texture2D* Knee::RenderableObject::getTexture(){
 	return this->m_texture;
 }
 
 void Knee::RenderableObject::setTexture(Knee::Texture2D* texture){
 	this->m_texture = texture;
+
+	this->updateRenderStateVersion();
 }
 
 bool Knee::RenderableObject::hasTexture(){
 	return this->m_texture != NULL;
 }
 
+uint32_t Knee::RenderableObject::getLayerMask(){
+	return this->m_layerMask;
+}
+
+void Knee::RenderableObject::setLayerMask(uint32_t layerMask){
+	this->m_layerMask = layerMask;
+
+	this->updateRenderStateVersion();
+}
+
+uint32_t Knee::RenderableObject::getMaxPortalDepth(){
+	return this->m_maxPortalDepth;
+}
+
+void Knee::RenderableObject::setMaxPortalDepth(uint32_t maxPortalDepth){
+	this->m_maxPortalDepth = maxPortalDepth;
+
+	this->updateRenderStateVersion();
+}
+
+bool Knee::RenderableObject::isInPass(uint32_t layerMask, uint32_t portalDepth){
+	return (this->m_layerMask & layerMask) != 0 && portalDepth <= this->m_maxPortalDepth;
+}
+
+void Knee::RenderableObject::updateRenderStateVersion(){
+	this->m_renderStateVersion = ++Knee::RenderableObject::LATEST_RENDER_STATE_VERSION;
+}
+
+uint64_t Knee::RenderableObject::getRenderStateVersion() const {
+	return this->m_renderStateVersion;
+}
+
+uint64_t Knee::RenderableObject::getLatestRenderStateVersion(){
+	return Knee::RenderableObject::LATEST_RENDER_STATE_VERSION;
+}
+
+bool Knee::RenderableObject::hasCustomDraw(){
+	return false;
+}
+
 void Knee::RenderableObject::draw(){
 	// reset bound textures in shader program
 	// TODO: should probably have some kind of system in place to keep textures from previous binds
 	this->m_shaderProgram->resetBoundTextures();
 
-	// calculate mvp matrix
-	glm::mat4 mvp = this->m_shaderProgram->getCamera()->getViewProjectionMatrix() * this->getModelMatrix();
-	
-	// calculate transposeInverseModel matrix
-	glm::mat4 tim = glm::transpose(glm::inverse(this->getModelMatrix()));
-	
+	Knee::PerspectiveCamera* camera = this->m_shaderProgram->getCamera();
+
+	// use the simplest level of detail that still looks the same from here
+	const Knee::VertexData* vertexData = this->getVertexData();
+
+	if(vertexData->getLODCount() > 0){
+		glm::vec3 center;
+		float radius;
+
+		this->getBoundingSphere(center, radius);
+
+		glm::vec3 scale = glm::abs(this->getScale());
+
+		vertexData = vertexData->getLOD(camera->getPixelsPerUnit(center, radius) * std::max(scale.x, std::max(scale.y, scale.z)));
+	}
+
+	// the camera's matrices come from its uniform buffer, so only the model matrix is needed here
+	camera->useUniformBuffer();
+
 	// set uniforms
-	this->m_shaderProgram->setUniformMat4("u_mvp", mvp);
-	this->m_shaderProgram->setUniformMat4("transposeInverseModel", tim);
+	const Knee::RenderableObjectUniforms& uniforms = this->m_shaderProgram->getUniforms();
+
+	this->m_shaderProgram->setUniform(uniforms.model, this->getModelMatrix());
+
+	// not one of the draw list's instances, so the shader has to use u_model
+	this->m_shaderProgram->setUniform(uniforms.instanceBase, -1);
 	
-	// bind texture if present
+	// bind texture if present, otherwise make sure we don't sample whatever was drawn before us
 	if(this->hasTexture()){
-		this->m_shaderProgram->bindTexture2D("u_sampler", this->getTexture());
+		this->m_shaderProgram->bindTexture2D(uniforms.sampler, this->getTexture());
+	} else {
+		this->m_shaderProgram->setUniform(uniforms.sampler, 0);
+		Knee::GLState::bindTexture(0, GL_TEXTURE_2D, 0);
 	}
 
 	// draw vertex data
-	this->m_shaderProgram->drawVertexData( this->getVertexData() );
+	this->m_shaderProgram->drawVertexData( vertexData );
 }
\ No newline at end of file
@@ -0,0 +1,247 @@
+#include <NonEuclideanEngine/staticbatch.hpp>
+#include <NonEuclideanEngine/cell.hpp>
+
+#include <map>
+#include <tuple>
+#include <utility>
+
+// -------------------- //
+// StaticBatch //
+
+Knee::StaticBatch::StaticBatch(Knee::VertexData* mergedVertexData, Knee::Texture2D* texture, Knee::RenderableObjectShaderProgram* program, const std::vector<Knee::RenderableObject*>& sources) : RenderableObject(mergedVertexData, texture, program), m_mergedVertexData(mergedVertexData), m_sources(sources) {
+	// the vertices are already in world space, so this only gives the batch a transform version newer than anything cached from before it existed
+	this->setPosition(glm::vec3(0));
+}
+
+Knee::StaticBatch::~StaticBatch(){
+	delete this->m_mergedVertexData;
+}
+
+std::vector<Knee::RenderableObject*>* Knee::StaticBatch::getSources(){
+	return &this->m_sources;
+}
+
+// -------------------- //
+// StaticBatcher //
+
+Knee::StaticBatcher::StaticBatcher(){}
+
+Knee::StaticBatcher::~StaticBatcher(){
+	this->clear();
+}
+
+bool Knee::StaticBatcher::canBatch(Knee::RenderableObject* obj){
+	const Knee::VertexData* vertexData = obj->getVertexData();
+
+	if(obj->hasCustomDraw() || obj->getShaderProgram() == NULL || vertexData == NULL) return false;
+
+	// nothing to put in world space
+	return vertexData->getAttributeOffset(Knee::VertexData::VA_POSITION_STR) >= 0;
+}
+
+void Knee::StaticBatcher::bake(const std::vector<Knee::RenderableObject*>& objects, const std::vector<Knee::Cell*>& cells){
+	this->clear();
+
+	// anything transformed after this has moved since the bake
+	this->m_bakeVersion = Knee::GeneralObject::getLatestTransformVersion();
+	this->m_bakeRenderStateVersion = Knee::RenderableObject::getLatestRenderStateVersion();
+	this->m_baked = true;
+
+	// objects in different cells are seen from different places, so they can't share a batch
+	std::unordered_map<Knee::RenderableObject*, Knee::Cell*> objectCells;
+
+	for(uint32_t i = 0; i < cells.size(); i++){
+		std::vector<Knee::RenderableObject*>* cellObjects = cells.at(i)->getRenderableObjects();
+
+		for(uint32_t j = 0; j < cellObjects->size(); j++){
+			objectCells[cellObjects->at(j)] = cells.at(i);
+		}
+	}
+
+	// group objects by everything that has to be the same for them to be drawn together, keeping groups in the order they're first seen
+	typedef std::tuple<Knee::Cell*, Knee::RenderableObjectShaderProgram*, Knee::Texture2D*, uint32_t, uint32_t, std::string> GroupKey;
+
+	std::map<GroupKey, uint32_t> groupIndices;
+	std::vector<std::vector<Knee::RenderableObject*>> groups;
+
+	for(uint32_t i = 0; i < objects.size(); i++){
+		Knee::RenderableObject* obj = objects.at(i);
+
+		if(!Knee::StaticBatcher::canBatch(obj)) continue;
+
+		std::unordered_map<Knee::RenderableObject*, Knee::Cell*>::iterator cell = objectCells.find(obj);
+
+		GroupKey key(cell == objectCells.end() ? NULL : cell->second, obj->getShaderProgram(), obj->getTexture(), obj->getLayerMask(), obj->getMaxPortalDepth(), obj->getVertexData()->getAttributeOrder());
+
+		std::map<GroupKey, uint32_t>::iterator group = groupIndices.find(key);
+
+		if(group == groupIndices.end()){
+			groupIndices[key] = groups.size();
+			groups.push_back({ obj });
+		} else {
+			groups.at(group->second).push_back(obj);
+		}
+	}
+
+	for(uint32_t i = 0; i < groups.size(); i++){
+		std::vector<Knee::RenderableObject*>& group = groups.at(i);
+
+		// split into batches small enough to still be culled
+		std::vector<Knee::RenderableObject*> batchObjects;
+		uint32_t batchVertexCount = 0;
+
+		for(uint32_t j = 0; j <= group.size(); j++){
+			uint32_t vertexCount = j < group.size() ? group.at(j)->getVertexData()->getVertexCount() : 0;
+
+			if(j == group.size() || (batchVertexCount > 0 && batchVertexCount + vertexCount > Knee::StaticBatcher::MAX_BATCH_VERTICES)){
+				// a single object is already one draw
+				if(batchObjects.size() > 1){
+					Knee::StaticBatch* batch = this->createBatch(batchObjects);
+
+					this->m_batches.push_back(batch);
+
+					for(uint32_t k = 0; k < batchObjects.size(); k++){
+						this->m_objectBatches[batchObjects.at(k)] = batch;
+					}
+				}
+
+				batchObjects.clear();
+				batchVertexCount = 0;
+			}
+
+			if(j == group.size()) break;
+
+			batchObjects.push_back(group.at(j));
+			batchVertexCount += vertexCount;
+		}
+	}
+}
+
+Knee::StaticBatch* Knee::StaticBatcher::createBatch(const std::vector<Knee::RenderableObject*>& objects){
+	Knee::RenderableObject* first = objects.at(0);
+	const Knee::VertexData* firstVertexData = first->getVertexData();
+
+	// every object in a group has the same layout
+	std::string attributeOrder = firstVertexData->getAttributeOrder();
+	uint32_t stride = firstVertexData->getStride();
+	int32_t positionOffset = firstVertexData->getAttributeOffset(Knee::VertexData::VA_POSITION_STR);
+	int32_t normalOffset = firstVertexData->getAttributeOffset(Knee::VertexData::VA_NORMAL_STR);
+
+	std::vector<float> merged;
+	std::vector<uint32_t> mergedIndices;
+
+	std::vector<float> data;
+	std::vector<uint32_t> indices;
+	uint32_t vertexCount = 0;
+
+	for(uint32_t i = 0; i < objects.size(); i++){
+		Knee::RenderableObject* obj = objects.at(i);
+		const Knee::VertexData* vertexData = obj->getVertexData();
+
+		vertexData->readData(data);
+		vertexData->readIndices(indices);
+
+		glm::mat4 model = obj->getModelMatrix();
+		glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(model)));
+
+		for(uint32_t j = 0; j < vertexData->getVertexCount(); j++){
+			float* vertex = data.data() + j*stride;
+
+			float* p = vertex + positionOffset;
+			glm::vec3 position = glm::vec3(model * glm::vec4(p[0], p[1], p[2], 1.0f));
+
+			p[0] = position.x;
+			p[1] = position.y;
+			p[2] = position.z;
+
+			if(normalOffset >= 0){
+				float* n = vertex + normalOffset;
+				glm::vec3 normal = normalMatrix * glm::vec3(n[0], n[1], n[2]);
+
+				// a zero length normal stays zero instead of becoming nan
+				if(glm::length(normal) > 0.0f) normal = glm::normalize(normal);
+
+				n[0] = normal.x;
+				n[1] = normal.y;
+				n[2] = normal.z;
+			}
+		}
+
+		// a mirroring transform turns every triangle inside out, so flip their winding back
+		bool mirrored = glm::determinant(glm::mat3(model)) < 0.0f;
+
+		for(uint32_t j = 0; j + 2 < indices.size(); j += 3){
+			if(mirrored) std::swap(indices.at(j + 1), indices.at(j + 2));
+
+			for(uint32_t k = 0; k < 3; k++){
+				mergedIndices.push_back(vertexCount + indices.at(j + k));
+			}
+		}
+
+		merged.insert(merged.end(), data.begin(), data.end());
+		vertexCount += vertexData->getVertexCount();
+	}
+
+	// world space positions are too far from the origin for half floats, but everything else can stay as packed as the first object's
+	uint32_t packing = firstVertexData->getPacking() & ~VERTEX_PACKING_HALF_POSITIONS;
+
+	Knee::VertexData* mergedVertexData = new Knee::VertexData(merged.data(), vertexCount, merged.size() * sizeof(float), attributeOrder, mergedIndices, packing);
+
+	Knee::StaticBatch* batch = new Knee::StaticBatch(mergedVertexData, first->getTexture(), first->getShaderProgram(), objects);
+
+	batch->setLayerMask(first->getLayerMask());
+	batch->setMaxPortalDepth(first->getMaxPortalDepth());
+
+	return batch;
+}
+
+void Knee::StaticBatcher::clear(){
+	for(uint32_t i = 0; i < this->m_batches.size(); i++){
+		delete this->m_batches.at(i);
+	}
+
+	this->m_batches.clear();
+	this->m_objectBatches.clear();
+
+	this->m_baked = false;
+}
+
+bool Knee::StaticBatcher::isBaked(){
+	return this->m_baked;
+}
+
+bool Knee::StaticBatcher::isStale(){
+	for(std::unordered_map<Knee::RenderableObject*, Knee::StaticBatch*>::iterator it = this->m_objectBatches.begin(); it != this->m_objectBatches.end(); it++){
+		if(it->first->getTransformVersion() > this->m_bakeVersion) return true;
+		if(it->first->getRenderStateVersion() > this->m_bakeRenderStateVersion) return true;
+	}
+
+	return false;
+}
+
+void Knee::StaticBatcher::substitute(const std::vector<Knee::RenderableObject*>& objects, std::vector<Knee::RenderableObject*>& drawn){
+	drawn.clear();
+
+	// batches already added
+	std::unordered_map<Knee::StaticBatch*, bool> added;
+
+	for(uint32_t i = 0; i < objects.size(); i++){
+		Knee::RenderableObject* obj = objects.at(i);
+
+		std::unordered_map<Knee::RenderableObject*, Knee::StaticBatch*>::iterator batch = this->m_objectBatches.find(obj);
+
+		if(batch == this->m_objectBatches.end()){
+			drawn.push_back(obj);
+			continue;
+		}
+
+		if(added[batch->second]) continue;
+
+		added[batch->second] = true;
+		drawn.push_back(batch->second);
+	}
+}
+
+uint32_t Knee::StaticBatcher::getBatchCount(){
+	return this->m_batches.size();
+}
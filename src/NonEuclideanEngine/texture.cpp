@@ -1,4 +1,6 @@
 #include <NonEuclideanEngine/texture.hpp>
+#include <NonEuclideanEngine/misc.hpp>
+#include <NonEuclideanEngine/glstate.hpp>
 
 #include <SDL2/SDL_image.h>
 #include <iostream>
@@ -16,11 +18,21 @@ Knee::Texture2D::Texture2D(std::string filename){
 	SDL_FreeSurface(surface);
 }
 
-Knee::Texture2D::Texture2D(uint32_t width, uint32_t height) {
-	this->createGLTexture(GL_RGB, width, height, GL_RGB, GL_UNSIGNED_BYTE, NULL);
+Knee::Texture2D::Texture2D(uint32_t width, uint32_t height, GLenum internalFormat) {
+	this->createGLTexture(internalFormat, width, height, GL_RGB, GL_UNSIGNED_BYTE, NULL);
+
+	// blank textures are generally rendered to and then sampled by screen position, so don't let filtering wrap around to the other side
+	Knee::GLState::bindTexture(0, GL_TEXTURE_2D, this->m_glTexture);
+
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+	Knee::GLState::bindTexture(0, GL_TEXTURE_2D, 0);
 };
 
-Knee::Texture2D::~Texture2D(){}
+Knee::Texture2D::~Texture2D(){
+	Knee::GLState::deleteTexture(this->m_glTexture);
+}
 
 uint32_t Knee::Texture2D::getWidth(){
 	return this->m_width;
@@ -30,6 +42,10 @@ uint32_t Knee::Texture2D::getHeight(){
 	return this->m_height;
 }
 
+GLenum Knee::Texture2D::getInternalFormat(){
+	return this->m_internalFormat;
+}
+
 GLint Knee::Texture2D::SDLPixelFormatToInternalGLFormat(const SDL_PixelFormat* sdlFormat){
 	if (sdlFormat == NULL) {
 		return -1;
@@ -69,15 +85,16 @@ GLint Knee::Texture2D::SDLPixelFormatToGLFormat(const SDL_PixelFormat* sdlFormat
 }
 
 void Knee::Texture2D::createGLTexture(GLenum internalFormat, uint32_t width, uint32_t height, GLenum format, GLenum type, const GLvoid* data){
-	// copy width + height into member variables
+	// copy width + height + format into member variables
 	this->m_width = width;
 	this->m_height = height;
+	this->m_internalFormat = internalFormat;
 
 	// generate 1 texture
 	glGenTextures(1, &this->m_glTexture);
 
 	// bind texture for 2D texture operations
-	glBindTexture(GL_TEXTURE_2D, this->m_glTexture);
+	Knee::GLState::bindTexture(0, GL_TEXTURE_2D, this->m_glTexture);
 
 	glTexImage2D(GL_TEXTURE_2D, 0, 
 		internalFormat,
@@ -93,7 +110,7 @@ void Knee::Texture2D::createGLTexture(GLenum internalFormat, uint32_t width, uin
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
 	// unbind
-	glBindTexture(GL_TEXTURE_2D, 0);
+	Knee::GLState::bindTexture(0, GL_TEXTURE_2D, 0);
 }
 
 // create gl texture from current surface
@@ -105,7 +122,7 @@ void Knee::Texture2D::createGLTexture(SDL_Surface* surface){
 	this->createGLTexture(internalFormat, surface->w, surface->h, format, GL_UNSIGNED_BYTE, surface->pixels);
 
 	// bind texture
-	glBindTexture(GL_TEXTURE_2D, this->m_glTexture);
+	Knee::GLState::bindTexture(0, GL_TEXTURE_2D, this->m_glTexture);
 
 	// set unpack alignment
 	// FIXME: actually match this with the given format
@@ -121,7 +138,7 @@ void Knee::Texture2D::createGLTexture(SDL_Surface* surface){
 	glGenerateMipmap(GL_TEXTURE_2D);
 
 	// unbind
-	glBindTexture(GL_TEXTURE_2D, 0);
+	Knee::GLState::bindTexture(0, GL_TEXTURE_2D, 0);
 }
 
 GLint Knee::Texture2D::getGLTexture(){
@@ -131,7 +148,7 @@ GLint Knee::Texture2D::getGLTexture(){
 // -------------------- //
 // Framebuffer2D //
 
-Knee::Framebuffer2D::Framebuffer2D(uint32_t width, uint32_t height) : Texture2D(width, height) {
+Knee::Framebuffer2D::Framebuffer2D(uint32_t width, uint32_t height, GLenum internalFormat) : Texture2D(width, height, internalFormat), m_ownsRenderbuffer(true) {
 	// create framebuffer
 	glGenFramebuffers(1, &this->m_framebuffer);
 
@@ -141,23 +158,223 @@ Knee::Framebuffer2D::Framebuffer2D(uint32_t width, uint32_t height) : Texture2D(
 	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, this->getGLTexture(), 0);
 
 	// create renderbuffer for depth + stencil
-	glGenRenderbuffers(1, &this->m_framebuffer);
-	glBindRenderbuffer(GL_RENDERBUFFER, this->m_framebuffer); 
+	glGenRenderbuffers(1, &this->m_renderbuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, this->m_renderbuffer); 
 	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);  
 
-	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, this->m_framebuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, this->m_renderbuffer);
 
 	// reset to default framebuffer + renderbuffer
 	glBindRenderbuffer(GL_RENDERBUFFER, 0);
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	Knee::GLState::bindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+Knee::Framebuffer2D::Framebuffer2D(uint32_t width, uint32_t height, GLenum internalFormat, uint32_t depthStencilRenderbuffer) : Texture2D(width, height, internalFormat), m_renderbuffer(depthStencilRenderbuffer), m_ownsRenderbuffer(false) {
+	// create framebuffer
+	glGenFramebuffers(1, &this->m_framebuffer);
+
+	this->bind();
+
+	// bind to texture
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, this->getGLTexture(), 0);
+
+	// attach shared depth + stencil
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, this->m_renderbuffer);
+
+	// reset to default framebuffer
+	Knee::GLState::bindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
-Knee::Framebuffer2D::~Framebuffer2D(){}
+Knee::Framebuffer2D::~Framebuffer2D(){
+	Knee::GLState::deleteFramebuffer(this->m_framebuffer);
+
+	if(this->m_ownsRenderbuffer){
+		glDeleteRenderbuffers(1, &this->m_renderbuffer);
+	}
+}
 
 Knee::Texture2D* Knee::Framebuffer2D::getTexture2D(){
 	return static_cast<Knee::Texture2D*>(this);
 }
 
 void Knee::Framebuffer2D::bind(){
-	glBindFramebuffer(GL_FRAMEBUFFER, this->m_framebuffer);
+	Knee::GLState::bindFramebuffer(GL_FRAMEBUFFER, this->m_framebuffer);
+}
+
+void Knee::Framebuffer2D::blitColor(Knee::Framebuffer2D* target, uint32_t width, uint32_t height){
+	Knee::GLState::bindFramebuffer(GL_READ_FRAMEBUFFER, this->m_framebuffer);
+	Knee::GLState::bindFramebuffer(GL_DRAW_FRAMEBUFFER, target->m_framebuffer);
+
+	glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+
+	target->bind();
+}
+
+bool Knee::Framebuffer2D::isComplete(){
+	this->bind();
+
+	GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+
+	Knee::GLState::bindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	return status == GL_FRAMEBUFFER_COMPLETE;
+}
+
+// -------------------- //
+// FramebufferPool //
+
+Knee::FramebufferPool::FramebufferPool(){}
+
+Knee::FramebufferPool::~FramebufferPool(){
+	for(uint32_t i = 0; i < this->m_framebuffers.size(); i++){
+		delete this->m_framebuffers[i].framebuffer;
+	}
+
+	for(std::map<std::pair<uint32_t, uint32_t>, SharedRenderbuffer>::iterator it = this->m_depthStencilRenderbuffers.begin(); it != this->m_depthStencilRenderbuffers.end(); ++it){
+		glDeleteRenderbuffers(1, &it->second.renderbuffer);
+	}
+}
+
+Knee::Framebuffer2D* Knee::FramebufferPool::acquire(uint32_t width, uint32_t height, GLenum internalFormat){
+	// don't bother trying formats we already know don't work
+	if(this->m_unsupportedFormats.count(internalFormat) > 0){
+		internalFormat = GL_RGB8;
+	}
+
+	// look for a free framebuffer that matches
+	for(uint32_t i = 0; i < this->m_framebuffers.size(); i++){
+		PooledFramebuffer& pooled = this->m_framebuffers[i];
+
+		if(pooled.inUse) continue;
+
+		Knee::Framebuffer2D* framebuffer = pooled.framebuffer;
+
+		if(framebuffer->getWidth() != width || framebuffer->getHeight() != height || framebuffer->getInternalFormat() != internalFormat) continue;
+
+		pooled.inUse = true;
+		pooled.usedThisFrame = true;
+
+		return framebuffer;
+	}
+
+	// none free, so get a depth + stencil renderbuffer for this size
+	std::pair<uint32_t, uint32_t> size(width, height);
+
+	std::map<std::pair<uint32_t, uint32_t>, SharedRenderbuffer>::iterator it = this->m_depthStencilRenderbuffers.find(size);
+
+	if(it == this->m_depthStencilRenderbuffers.end()){
+		SharedRenderbuffer shared;
+		shared.users = 0;
+
+		glGenRenderbuffers(1, &shared.renderbuffer);
+		glBindRenderbuffer(GL_RENDERBUFFER, shared.renderbuffer);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+		glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+		it = this->m_depthStencilRenderbuffers.insert(std::make_pair(size, shared)).first;
+	}
+
+	it->second.users++;
+
+	// create new framebuffer
+	PooledFramebuffer pooled;
+	pooled.framebuffer = new Knee::Framebuffer2D(width, height, internalFormat, it->second.renderbuffer);
+	pooled.inUse = true;
+	pooled.usedThisFrame = true;
+	pooled.retained = false;
+
+	// fall back to a format every driver can render to
+	if(!pooled.framebuffer->isComplete() && internalFormat != GL_RGB8){
+		std::cout << Knee::WARNING_PREFACE << "framebuffer format " << internalFormat << " is not renderable, using GL_RGB8 instead" << std::endl;
+
+		this->destroyFramebuffer(pooled.framebuffer);
+
+		this->m_unsupportedFormats.insert(internalFormat);
+
+		return this->acquire(width, height, GL_RGB8);
+	}
+
+	this->m_framebuffers.push_back(pooled);
+
+	return pooled.framebuffer;
+}
+
+void Knee::FramebufferPool::release(Knee::Framebuffer2D* framebuffer){
+	for(uint32_t i = 0; i < this->m_framebuffers.size(); i++){
+		if(this->m_framebuffers[i].framebuffer == framebuffer){
+			this->m_framebuffers[i].inUse = false;
+			this->m_framebuffers[i].retained = false;
+			return;
+		}
+	}
+}
+
+void Knee::FramebufferPool::retain(Knee::Framebuffer2D* framebuffer){
+	for(uint32_t i = 0; i < this->m_framebuffers.size(); i++){
+		if(this->m_framebuffers[i].framebuffer == framebuffer){
+			this->m_framebuffers[i].retained = true;
+			return;
+		}
+	}
+}
+
+void Knee::FramebufferPool::destroyFramebuffer(Knee::Framebuffer2D* framebuffer){
+	std::pair<uint32_t, uint32_t> size(framebuffer->getWidth(), framebuffer->getHeight());
+
+	delete framebuffer;
+
+	// free the shared renderbuffer once nobody is using it anymore
+	std::map<std::pair<uint32_t, uint32_t>, SharedRenderbuffer>::iterator it = this->m_depthStencilRenderbuffers.find(size);
+
+	if(it == this->m_depthStencilRenderbuffers.end()) return;
+
+	it->second.users--;
+
+	if(it->second.users == 0){
+		glDeleteRenderbuffers(1, &it->second.renderbuffer);
+
+		this->m_depthStencilRenderbuffers.erase(it);
+	}
+}
+
+void Knee::FramebufferPool::endFrame(){
+	std::vector<PooledFramebuffer> kept;
+	kept.reserve(this->m_framebuffers.size());
+
+	for(uint32_t i = 0; i < this->m_framebuffers.size(); i++){
+		PooledFramebuffer pooled = this->m_framebuffers[i];
+
+		// still held on to, so it stays exactly as it is
+		if(pooled.retained){
+			kept.push_back(pooled);
+			continue;
+		}
+
+		// wasn't needed last frame, so free it
+		if(!pooled.usedThisFrame){
+			this->destroyFramebuffer(pooled.framebuffer);
+			continue;
+		}
+
+		pooled.inUse = false;
+		pooled.usedThisFrame = false;
+
+		kept.push_back(pooled);
+	}
+
+	this->m_framebuffers = kept;
+}
+
+uint32_t Knee::FramebufferPool::getFramebufferCount(){
+	return this->m_framebuffers.size();
+}
+
+uint32_t Knee::FramebufferPool::getInUseCount(){
+	uint32_t count = 0;
+
+	for(uint32_t i = 0; i < this->m_framebuffers.size(); i++){
+		if(this->m_framebuffers[i].inUse) count++;
+	}
+
+	return count;
 }
\ No newline at end of file
@@ -126,7 +126,9 @@ int main(int argc, char* argv[]){
 	uint32_t testSize = 36;
 	uint32_t testSizeBytes = testSize * 8 * sizeof(float);
 	
-	Knee::VertexData testVertexData(testRawVertexData, testSize, testSizeBytes, "pnt");
+	// small enough in model space to be packed as tightly as possible
+	// a cube only has 12 triangles, so one simplified level is all it can give
+	Knee::VertexData testVertexData(testRawVertexData, testSize, testSizeBytes, "pnt", 1, Knee::VERTEX_PACKING_ALL);
 	
 	float portalRawVertexData[] = {
 		// positions          // normals           // texture coords
@@ -175,10 +177,10 @@ int main(int argc, char* argv[]){
 	game->getPlayer()->setPosition( glm::vec3(-20, 1.5, 0) );
 
 	// create portals
-	Knee::Portal portal1(&portalVertexData, windowWidth, windowHeight);
-	Knee::Portal portal2(&portalVertexData, windowWidth, windowHeight);
-	Knee::Portal portal3(&portalVertexData, windowWidth, windowHeight);
-	Knee::Portal portal4(&portalVertexData, windowWidth, windowHeight);
+	Knee::Portal portal1(&portalVertexData);
+	Knee::Portal portal2(&portalVertexData);
+	Knee::Portal portal3(&portalVertexData);
+	Knee::Portal portal4(&portalVertexData);
 
 	// assign properties
 	portal1.setPosition(glm::vec3(-20, 2.5, -3));
@@ -210,6 +212,9 @@ int main(int argc, char* argv[]){
 	//game->addPortal( "portal3", &portal3 );
 	//game->addPortal( "portal4", &portal4 );
 
+	// merge the map's static geometry now instead of on the first frame.  anything added after this would throw the batches away
+	game->bakeStaticBatches();
+
 	// misc settings
 	app.setMaxFPS(120);
 	